@@ -0,0 +1,441 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+// Offline benchmark of the column formatters. Synthetic message buffers of every
+// SQL type are passed through FormatPlan, CSVFile and OutputBuffer exactly like
+// the fetched rows, the output goes to a sink that only counts the bytes.
+// No database is needed, the client library provides only the IUtil interface.
+//
+// Usage: CSVExportBench [name_filter]
+
+#include "FormatPlan.h"
+#include "CSVFile.h"
+#include "TemporalFormat.h"
+#include <firebird/Interface.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using FBExport::FormatPlan;
+    using FBExport::FormatContext;
+    using FBExport::FormatOptions;
+
+    // Columns of the benchmarked type in each row
+    constexpr unsigned BENCH_COLUMNS = 8;
+    // Distinct rows, the values are reused in every pass
+    constexpr size_t BENCH_ROWS = 4096;
+    // Minimal measured time of one type
+    constexpr auto BENCH_TIME = std::chrono::milliseconds(500);
+
+    // Counts the bytes instead of writing them, so the disk is not measured
+    class NullSink final : public csv::OutputSink
+    {
+    public:
+        uint64_t bytes = 0;
+
+        void write(const char*, size_t size) override
+        {
+            bytes += size;
+        }
+    };
+
+    using Random = std::mt19937_64;
+
+    using FillFunc = void (*)(Firebird::ThrowStatusWrapper* status, Firebird::IUtil* util, Random& rnd, const Firebird::SQLDA& field, unsigned char* value);
+
+    struct BenchCase
+    {
+        const char* name;
+        unsigned type;
+        unsigned length;
+        int scale;
+        unsigned charset;
+        FillFunc fill;
+    };
+
+    template <typename T>
+    void store(unsigned char* value, const T& data)
+    {
+        std::memcpy(value, &data, sizeof(T));
+    }
+
+    template <typename T>
+    T randomInt(Random& rnd)
+    {
+        // short values are as common as long ones
+        const unsigned bits = 1 + static_cast<unsigned>(rnd() % (sizeof(T) * 8 - 1));
+        const auto magnitude = static_cast<int64_t>(rnd() >> (64 - bits));
+        return static_cast<T>(rnd() & 1 ? magnitude : -magnitude);
+    }
+
+    void fillShort(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        store(value, randomInt<short>(rnd));
+    }
+
+    void fillLong(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        store(value, randomInt<int>(rnd));
+    }
+
+    void fillInt64(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        store(value, randomInt<int64_t>(rnd));
+    }
+
+    void fillInt128(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        // two's complement, the low part first
+        FB_I128 data;
+        const int64_t high = randomInt<int64_t>(rnd) >> (rnd() % 64);
+        data.fb_data[0] = rnd();
+        data.fb_data[1] = static_cast<ISC_UINT64>(high);
+        store(value, data);
+    }
+
+    void fillFloat(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        std::uniform_real_distribution<float> dist(-1e6f, 1e6f);
+        store(value, dist(rnd));
+    }
+
+    void fillDouble(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        std::uniform_real_distribution<double> dist(-1e9, 1e9);
+        store(value, dist(rnd));
+    }
+
+    void fillDecFloat16(Firebird::ThrowStatusWrapper* status, Firebird::IUtil* util, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        const std::string text = std::to_string(randomInt<int>(rnd)) + "." + std::to_string(rnd() % 10000);
+        FB_DEC16 data;
+        util->getDecFloat16(status)->fromString(status, text.c_str(), &data);
+        store(value, data);
+    }
+
+    void fillDecFloat34(Firebird::ThrowStatusWrapper* status, Firebird::IUtil* util, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        const std::string text = std::to_string(randomInt<int64_t>(rnd)) + "." + std::to_string(rnd() % 1000000);
+        FB_DEC34 data;
+        util->getDecFloat34(status)->fromString(status, text.c_str(), &data);
+        store(value, data);
+    }
+
+    // Printable text, quoted is a share of the values with quotes and separators
+    std::string randomText(Random& rnd, size_t maxLength, bool quoted)
+    {
+        static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+        static const char special[] = "\",;\n";
+        std::string ret(1 + rnd() % maxLength, ' ');
+        for (auto& c : ret) {
+            c = letters[rnd() % (sizeof(letters) - 1)];
+        }
+        if (quoted) {
+            ret[rnd() % ret.size()] = special[rnd() % (sizeof(special) - 1)];
+        }
+        return ret;
+    }
+
+    void fillChar(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA& field, unsigned char* value)
+    {
+        // CHAR is padded with spaces up to the declared length
+        const std::string text = randomText(rnd, field.length, false);
+        std::memset(value, ' ', field.length);
+        std::memcpy(value, text.data(), text.size());
+    }
+
+    void fillVarChar(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA& field, unsigned char* value)
+    {
+        const std::string text = randomText(rnd, field.length, false);
+        store(value, static_cast<unsigned short>(text.size()));
+        std::memcpy(value + 2, text.data(), text.size());
+    }
+
+    void fillQuotedVarChar(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA& field, unsigned char* value)
+    {
+        const std::string text = randomText(rnd, field.length, true);
+        store(value, static_cast<unsigned short>(text.size()));
+        std::memcpy(value + 2, text.data(), text.size());
+    }
+
+    void fillBinary(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA& field, unsigned char* value)
+    {
+        for (unsigned i = 0; i < field.length; i++) {
+            value[i] = static_cast<unsigned char>(rnd());
+        }
+    }
+
+    void fillVarBinary(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA& field, unsigned char* value)
+    {
+        const auto length = static_cast<unsigned short>(1 + rnd() % field.length);
+        store(value, length);
+        for (unsigned i = 0; i < length; i++) {
+            value[2 + i] = static_cast<unsigned char>(rnd());
+        }
+    }
+
+    ISC_DATE randomDate(Random& rnd)
+    {
+        // 1900..2100
+        return static_cast<ISC_DATE>(15020 + rnd() % 73000);
+    }
+
+    ISC_TIME randomTime(Random& rnd)
+    {
+        return static_cast<ISC_TIME>(rnd() % (24ull * 3600 * 10000));
+    }
+
+    unsigned short randomOffsetZone(Random& rnd)
+    {
+        // whole hours and half hours from -12:00 to +14:00
+        return static_cast<unsigned short>(FBExport::TIME_ZONE_ONE_DAY - 720 + 30 * (rnd() % 53));
+    }
+
+    void fillDate(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        store(value, randomDate(rnd));
+    }
+
+    void fillTime(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        store(value, randomTime(rnd));
+    }
+
+    void fillTimestamp(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        ISC_TIMESTAMP data;
+        data.timestamp_date = randomDate(rnd);
+        data.timestamp_time = randomTime(rnd);
+        store(value, data);
+    }
+
+    void fillTimestampTz(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        ISC_TIMESTAMP_TZ data;
+        data.utc_timestamp.timestamp_date = randomDate(rnd);
+        data.utc_timestamp.timestamp_time = randomTime(rnd);
+        data.time_zone = randomOffsetZone(rnd);
+        store(value, data);
+    }
+
+    void fillTimeTz(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        ISC_TIME_TZ data;
+        data.utc_time = randomTime(rnd);
+        data.time_zone = randomOffsetZone(rnd);
+        store(value, data);
+    }
+
+    void fillTimestampTzEx(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        ISC_TIMESTAMP_TZ_EX data;
+        data.utc_timestamp.timestamp_date = randomDate(rnd);
+        data.utc_timestamp.timestamp_time = randomTime(rnd);
+        data.time_zone = randomOffsetZone(rnd);
+        data.ext_offset = static_cast<ISC_SHORT>(FBExport::offsetTimeZoneMinutes(data.time_zone));
+        store(value, data);
+    }
+
+    void fillTimeTzEx(Firebird::ThrowStatusWrapper*, Firebird::IUtil*, Random& rnd, const Firebird::SQLDA&, unsigned char* value)
+    {
+        ISC_TIME_TZ_EX data;
+        data.utc_time = randomTime(rnd);
+        data.time_zone = randomOffsetZone(rnd);
+        data.ext_offset = static_cast<ISC_SHORT>(FBExport::offsetTimeZoneMinutes(data.time_zone));
+        store(value, data);
+    }
+
+    // charset 1 is OCTETS, 4 is UTF8
+    const BenchCase BENCH_CASES[] = {
+        { "SMALLINT", SQL_SHORT, 2, 0, 0, fillShort },
+        { "INTEGER", SQL_LONG, 4, 0, 0, fillLong },
+        { "BIGINT", SQL_INT64, 8, 0, 0, fillInt64 },
+        { "NUMERIC(4,2)", SQL_SHORT, 2, -2, 0, fillShort },
+        { "NUMERIC(9,2)", SQL_LONG, 4, -2, 0, fillLong },
+        { "NUMERIC(18,4)", SQL_INT64, 8, -4, 0, fillInt64 },
+        { "INT128", SQL_INT128, 16, 0, 0, fillInt128 },
+        { "NUMERIC(38,6)", SQL_INT128, 16, -6, 0, fillInt128 },
+        { "FLOAT", SQL_FLOAT, 4, 0, 0, fillFloat },
+        { "DOUBLE PRECISION", SQL_DOUBLE, 8, 0, 0, fillDouble },
+        { "DECFLOAT(16)", SQL_DEC16, 8, 0, 0, fillDecFloat16 },
+        { "DECFLOAT(34)", SQL_DEC34, 16, 0, 0, fillDecFloat34 },
+        { "CHAR(20)", SQL_TEXT, 20, 0, 4, fillChar },
+        { "VARCHAR(40)", SQL_VARYING, 40, 0, 4, fillVarChar },
+        { "VARCHAR(40) quoted", SQL_VARYING, 40, 0, 4, fillQuotedVarChar },
+        { "BINARY(16)", SQL_TEXT, 16, 0, 1, fillBinary },
+        { "BINARY(20)", SQL_TEXT, 20, 0, 1, fillBinary },
+        { "VARBINARY(32)", SQL_VARYING, 32, 0, 1, fillVarBinary },
+        { "DATE", SQL_TYPE_DATE, 4, 0, 0, fillDate },
+        { "TIME", SQL_TYPE_TIME, 4, 0, 0, fillTime },
+        { "TIMESTAMP", SQL_TIMESTAMP, 8, 0, 0, fillTimestamp },
+        { "TIME WITH TIME ZONE", SQL_TIME_TZ, sizeof(ISC_TIME_TZ), 0, 0, fillTimeTz },
+        { "TIMESTAMP WITH TIME ZONE", SQL_TIMESTAMP_TZ, sizeof(ISC_TIMESTAMP_TZ), 0, 0, fillTimestampTz },
+        { "TIME WITH TIME ZONE EX", SQL_TIME_TZ_EX, sizeof(ISC_TIME_TZ_EX), 0, 0, fillTimeTzEx },
+        { "TIMESTAMP WITH TIME ZONE EX", SQL_TIMESTAMP_TZ_EX, sizeof(ISC_TIMESTAMP_TZ_EX), 0, 0, fillTimestampTzEx },
+    };
+
+    unsigned typeAlignment(unsigned type)
+    {
+        switch (type) {
+        case SQL_TEXT:
+            return 1;
+        case SQL_VARYING:
+        case SQL_SHORT:
+            return 2;
+        case SQL_INT64:
+        case SQL_DOUBLE:
+        case SQL_DEC16:
+        case SQL_DEC34:
+        case SQL_INT128:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
+    unsigned alignUp(unsigned value, unsigned alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Lays out the columns like the server message: every value is aligned
+    // by its type and followed by the NULL indicator. Returns the message length.
+    unsigned makeFields(const BenchCase& bench, Firebird::SQLDAList& fields)
+    {
+        const unsigned valueLength = bench.type == SQL_VARYING ? bench.length + 2 : bench.length;
+        unsigned length = 0;
+        for (unsigned i = 0; i < BENCH_COLUMNS; i++) {
+            Firebird::SQLDA field;
+            field.type = bench.type;
+            field.length = bench.length;
+            field.scale = bench.scale;
+            field.charset = bench.charset;
+            field.nullable = true;
+            field.offset = alignUp(length, typeAlignment(bench.type));
+            field.nullOffset = alignUp(field.offset + valueLength, 2);
+            length = field.nullOffset + 2;
+            fields.push_back(field);
+        }
+        return alignUp(length, 8);
+    }
+
+    struct BenchResult
+    {
+        uint64_t values = 0;
+        uint64_t bytes = 0;
+        std::chrono::nanoseconds time{ 0 };
+    };
+
+    BenchResult runCase(Firebird::IMaster* master, const BenchCase& bench)
+    {
+        Firebird::ThrowStatusWrapper status(master->getStatus());
+        Firebird::IUtil* util = master->getUtilInterface();
+
+        Firebird::SQLDAList fields;
+        const unsigned stride = makeFields(bench, fields);
+        std::vector<unsigned char> messages(BENCH_ROWS * stride);
+        Random rnd(20240601);
+        for (size_t row = 0; row < BENCH_ROWS; row++) {
+            unsigned char* message = messages.data() + row * stride;
+            for (const auto& field : fields) {
+                bench.fill(&status, util, rnd, field, message + field.offset);
+                store(message + field.nullOffset, static_cast<short>(0));
+            }
+        }
+
+        FormatPlan plan;
+        plan.compile(fields);
+        FormatOptions options;
+        FormatContext ctx(&status, master, options);
+        NullSink sink;
+        csv::OutputBuffer buffer;
+        csv::CSVFile csv(sink, buffer, ",");
+
+        auto pass = [&] {
+            const unsigned char* message = messages.data();
+            for (size_t row = 0; row < BENCH_ROWS; row++, message += stride) {
+                plan.formatRow(ctx, message, csv);
+            }
+        };
+
+        // the first pass warms up the caches and the buffer
+        pass();
+        csv.flush();
+        const uint64_t warmupBytes = sink.bytes;
+
+        BenchResult result;
+        const auto start = std::chrono::steady_clock::now();
+        do {
+            pass();
+            result.values += BENCH_ROWS * BENCH_COLUMNS;
+            result.time = std::chrono::steady_clock::now() - start;
+        } while (result.time < BENCH_TIME);
+        csv.close();
+        result.time = std::chrono::steady_clock::now() - start;
+        result.bytes = sink.bytes - warmupBytes;
+
+        status.dispose();
+        return result;
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    const std::string filter = argc > 1 ? argv[1] : "";
+    Firebird::IMaster* master = Firebird::fb_get_master_interface();
+
+    std::printf("%-30s %12s %12s %14s\n", "type", "ns/value", "MB/s", "values/s");
+    try {
+        for (const auto& bench : BENCH_CASES) {
+            if (!filter.empty() && std::string(bench.name).find(filter) == std::string::npos) {
+                continue;
+            }
+            const BenchResult result = runCase(master, bench);
+            const double seconds = std::chrono::duration<double>(result.time).count();
+            std::printf("%-30s %12.2f %12.1f %14.0f\n",
+                bench.name,
+                std::chrono::duration<double, std::nano>(result.time).count() / result.values,
+                result.bytes / seconds / (1000.0 * 1000.0),
+                result.values / seconds);
+        }
+    }
+    catch (const Firebird::FbException& e) {
+        char buffer[2048];
+        master->getUtilInterface()->formatStatus(buffer, static_cast<unsigned int>(sizeof(buffer)), e.getStatus());
+        std::cerr << "Error: " << buffer << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+// Creates the database of the end-to-end benchmark and fills it with synthetic tables.
+// The tables take turns between three row shapes: narrow rows of two numbers, rows with
+// a column of every SQL type, and wide rows of many strings. Each table has fewer rows
+// than the previous one by the skew ratio, so the run has a few large tables and a long
+// tail of small ones, like a real database. The rows are generated by the server in
+// EXECUTE BLOCK, nothing is sent per row, and the values depend only on the row number,
+// so the same options always give the same data. The binary values are SHA-256 hashes
+// of the row number, they compress as badly as random GUIDs.
+//
+// Usage: CSVExportGen -d database [-u user] [-p password] [--tables n] [--rows n] [--skew ratio]
+//                     [--wide-columns n] [--recreate]
+
+#include <firebird/Interface.h>
+#include "FBAutoPtr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr char HELP_INFO[] = R"(
+Usage CSVExportGen <options>
+    -h [ --help ]                        Show help
+    -d [ --database ] connection_string  Database to create
+    -u [ --username ] user               User name, default SYSDBA
+    -p [ --password ] password           Password, default masterkey
+    --tables count                       Number of tables, default 12
+    --rows count                         Rows of the largest table, default 1000000
+    --skew ratio                         Ratio of the sizes of the next tables, default 2
+    --wide-columns count                 String columns of the wide tables, default 40
+    --recreate                           Drop the database if it exists
+)";
+
+    // VARCHAR(100) in UTF8 takes 402 bytes of the 64 KB record limit
+    constexpr int MAX_WIDE_COLUMNS = 150;
+
+    struct GenOptions
+    {
+        std::string database;
+        std::string username{ "SYSDBA" };
+        std::string password{ "masterkey" };
+        unsigned tables = 12;
+        uint64_t rows = 1000000;
+        double skew = 2.0;
+        // strings of the wide tables
+        unsigned wideColumns = 40;
+        bool recreate = false;
+    };
+
+    // Column of a table with the value of the row number I
+    struct GenColumn
+    {
+        std::string name;
+        std::string type;
+        std::string value;
+    };
+
+    struct GenTable
+    {
+        std::string name;
+        std::vector<GenColumn> columns;
+        uint64_t rows = 0;
+    };
+
+    std::vector<GenColumn> narrowColumns()
+    {
+        return {
+            { "ID", "BIGINT NOT NULL", "I" },
+            { "V", "INTEGER", "MOD(I * 7919, 1000000)" }
+        };
+    }
+
+    // Every type exported by CSVExport, the nullable columns have NULL in some rows
+    std::vector<GenColumn> typedColumns()
+    {
+        return {
+            { "ID", "BIGINT NOT NULL", "I" },
+            { "C_SMALLINT", "SMALLINT", "MOD(I, 32000) - 16000" },
+            { "C_INTEGER", "INTEGER", "IIF(MOD(I, 17) = 0, NULL, MOD(I * 7919, 2000000000) - 1000000000)" },
+            { "C_BIGINT", "BIGINT", "I * 1000003" },
+            { "C_INT128", "INT128", "CAST(I AS INT128) * 100000000000000007" },
+            { "C_NUMERIC_9_2", "NUMERIC(9, 2)", "MOD(I, 1000000) / 100.00" },
+            { "C_NUMERIC_18_4", "NUMERIC(18, 4)", "I * 1.2345" },
+            { "C_NUMERIC_38_6", "NUMERIC(38, 6)", "CAST(I AS INT128) * 123456789.123456" },
+            { "C_FLOAT", "FLOAT", "I / 7.0" },
+            { "C_DOUBLE", "DOUBLE PRECISION", "I * 1.0e0 / 3" },
+            { "C_DECFLOAT16", "DECFLOAT(16)", "I / 7.0" },
+            { "C_DECFLOAT34", "DECFLOAT(34)", "I / 13.0" },
+            { "C_DATE", "DATE", "DATE '2000-01-01' + MOD(I, 10000)" },
+            { "C_TIME", "TIME", "DATEADD(MOD(I * 1237, 86400000) MILLISECOND TO TIME '00:00:00')" },
+            { "C_TIMESTAMP", "TIMESTAMP", "DATEADD(I * 1237 MILLISECOND TO TIMESTAMP '2000-01-01 00:00:00')" },
+            { "C_TIME_TZ", "TIME WITH TIME ZONE", "DATEADD(MOD(I, 86400) SECOND TO TIME '00:00:00') AT TIME ZONE '+03:00'" },
+            { "C_TIMESTAMP_TZ", "TIMESTAMP WITH TIME ZONE", "DATEADD(I * 61 SECOND TO TIMESTAMP '2000-01-01 00:00:00') AT TIME ZONE 'Europe/Moscow'" },
+            { "C_BOOLEAN", "BOOLEAN", "MOD(I, 2) = 0" },
+            { "C_CHAR", "CHAR(10)", "'C' || MOD(I, 1000)" },
+            { "C_VARCHAR", "VARCHAR(100)", "'row ' || I || IIF(MOD(I, 5) = 0, ', \"quoted\"', '')" },
+            { "C_GUID", "CHAR(16) CHARACTER SET OCTETS", "CAST(LEFT(CRYPT_HASH(CAST(I AS VARCHAR(20)) USING SHA256), 16) AS CHAR(16) CHARACTER SET OCTETS)" },
+            { "C_VARBINARY", "VARBINARY(32)", "LEFT(CRYPT_HASH(CAST(I AS VARCHAR(20)) USING SHA256), MOD(I, 32) + 1)" },
+            { "C_TEXT_BLOB", "BLOB SUB_TYPE TEXT", "IIF(MOD(I, 10) = 0, 'text blob ' || I, NULL)" },
+            { "C_BINARY_BLOB", "BLOB SUB_TYPE BINARY", "IIF(MOD(I, 10) = 0, CRYPT_HASH(CAST(I AS VARCHAR(20)) USING SHA256), NULL)" }
+        };
+    }
+
+    // Strings of different length, about 50 bytes per column in the average row
+    std::vector<GenColumn> wideColumns(unsigned count)
+    {
+        std::vector<GenColumn> columns = { { "ID", "BIGINT NOT NULL", "I" } };
+        for (unsigned i = 1; i <= count; i++) {
+            columns.push_back({
+                "S" + std::to_string(i),
+                "VARCHAR(100)",
+                "RPAD(I, MOD(I + " + std::to_string(i * 13) + ", 100), '-')" });
+        }
+        return columns;
+    }
+
+    std::vector<GenTable> planTables(const GenOptions& options)
+    {
+        std::vector<GenTable> tables;
+        double rows = static_cast<double>(options.rows);
+        for (unsigned i = 0; i < options.tables; i++) {
+            GenTable table;
+            const std::string number = (i < 10 ? "0" : "") + std::to_string(i);
+            switch (i % 3) {
+            case 0:
+                table.name = "BENCH_NARROW_" + number;
+                table.columns = narrowColumns();
+                break;
+            case 1:
+                table.name = "BENCH_TYPED_" + number;
+                table.columns = typedColumns();
+                break;
+            default:
+                table.name = "BENCH_WIDE_" + number;
+                table.columns = wideColumns(options.wideColumns);
+                break;
+            }
+            table.rows = std::max<uint64_t>(1, static_cast<uint64_t>(rows));
+            tables.push_back(std::move(table));
+            rows /= options.skew;
+        }
+        return tables;
+    }
+
+    std::string buildCreateTable(const GenTable& table)
+    {
+        std::string sql = "CREATE TABLE " + table.name + " (";
+        for (size_t i = 0; i < table.columns.size(); i++) {
+            sql += (i > 0 ? ", " : "") + table.columns[i].name + " " + table.columns[i].type;
+        }
+        return sql + ")";
+    }
+
+    std::string buildFill(const GenTable& table)
+    {
+        std::string names;
+        std::string values;
+        for (size_t i = 0; i < table.columns.size(); i++) {
+            names += (i > 0 ? ", " : "") + table.columns[i].name;
+            values += (i > 0 ? ", " : "") + table.columns[i].value;
+        }
+        return
+            "EXECUTE BLOCK AS\n"
+            "  DECLARE I BIGINT = 0;\n"
+            "BEGIN\n"
+            "  WHILE (I < " + std::to_string(table.rows) + ") DO\n"
+            "  BEGIN\n"
+            "    INSERT INTO " + table.name + " (" + names + ") VALUES (" + values + ");\n"
+            "    I = I + 1;\n"
+            "  END\n"
+            "END";
+    }
+
+    void execute(Firebird::ThrowStatusWrapper* status, Firebird::IAttachment* att, const std::string& sql)
+    {
+        Firebird::AutoRelease<Firebird::ITransaction> tra(att->startTransaction(status, 0, nullptr));
+        att->execute(status, tra, 0, sql.c_str(), 3, nullptr, nullptr, nullptr, nullptr);
+        tra->commit(status);
+        tra.release();
+    }
+
+    GenOptions parseArgs(int argc, const char** argv)
+    {
+        GenOptions options;
+        auto value = [&](int& i, const std::string& arg) -> std::string {
+            if (const auto pos = arg.find('='); arg.size() > 2 && pos != std::string::npos) {
+                return arg.substr(pos + 1);
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Error: the option '" << arg << "' requires a value" << std::endl;
+                exit(-1);
+            }
+            return argv[++i];
+        };
+        for (int i = 1; i < argc; i++) {
+            const std::string arg(argv[i]);
+            const std::string name = arg.substr(0, arg.find('='));
+            if (name == "-h" || name == "--help") {
+                std::cout << HELP_INFO << std::endl;
+                exit(0);
+            }
+            else if (name == "-d" || name == "--database") {
+                options.database = value(i, arg);
+            }
+            else if (name == "-u" || name == "--username") {
+                options.username = value(i, arg);
+            }
+            else if (name == "-p" || name == "--password") {
+                options.password = value(i, arg);
+            }
+            else if (name == "--tables") {
+                const int tables = std::stoi(value(i, arg));
+                if (tables <= 0 || tables > 1000) {
+                    std::cerr << "Error: number of tables must be between 1 and 1000" << std::endl;
+                    exit(-1);
+                }
+                options.tables = static_cast<unsigned>(tables);
+            }
+            else if (name == "--rows") {
+                const long long rows = std::stoll(value(i, arg));
+                if (rows <= 0) {
+                    std::cerr << "Error: number of rows must be greater than 0" << std::endl;
+                    exit(-1);
+                }
+                options.rows = static_cast<uint64_t>(rows);
+            }
+            else if (name == "--skew") {
+                options.skew = std::stod(value(i, arg));
+                if (options.skew < 1.0 || options.skew > 100.0) {
+                    std::cerr << "Error: skew ratio must be between 1 and 100" << std::endl;
+                    exit(-1);
+                }
+            }
+            else if (name == "--wide-columns") {
+                const int columns = std::stoi(value(i, arg));
+                if (columns <= 0 || columns > MAX_WIDE_COLUMNS) {
+                    std::cerr << "Error: number of wide columns must be between 1 and " << MAX_WIDE_COLUMNS << std::endl;
+                    exit(-1);
+                }
+                options.wideColumns = static_cast<unsigned>(columns);
+            }
+            else if (name == "--recreate") {
+                options.recreate = true;
+            }
+            else {
+                std::cerr << "Error: unknown option '" << arg << "'" << std::endl;
+                exit(-1);
+            }
+        }
+        if (options.database.empty()) {
+            std::cerr << "Error: the option '--database' is required but missing" << std::endl;
+            exit(-1);
+        }
+        return options;
+    }
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const GenOptions options = parseArgs(argc, argv);
+    Firebird::IMaster* master = Firebird::fb_get_master_interface();
+    Firebird::IUtil* util = master->getUtilInterface();
+    Firebird::ThrowStatusWrapper status(master->getStatus());
+
+    try {
+        Firebird::AutoRelease<Firebird::IProvider> provider(master->getDispatcher());
+        Firebird::AutoDispose<Firebird::IXpbBuilder> dpbBuilder(util->getXpbBuilder(&status, Firebird::IXpbBuilder::DPB, nullptr, 0));
+        dpbBuilder->insertString(&status, isc_dpb_user_name, options.username.c_str());
+        dpbBuilder->insertString(&status, isc_dpb_password, options.password.c_str());
+
+        if (options.recreate) {
+            Firebird::ThrowStatusWrapper dropStatus(master->getStatus());
+            try {
+                Firebird::AutoRelease<Firebird::IAttachment> old(provider->attachDatabase(
+                    &dropStatus, options.database.c_str(), dpbBuilder->getBufferLength(&status), dpbBuilder->getBuffer(&status)));
+                old->dropDatabase(&dropStatus);
+                old.release();
+            }
+            catch (const Firebird::FbException&) {
+                // there is no database yet
+            }
+            dropStatus.dispose();
+        }
+
+        // the generated data can be created again, so the forced writes are not needed
+        dpbBuilder->insertInt(&status, isc_dpb_sql_dialect, 3);
+        dpbBuilder->insertString(&status, isc_dpb_set_db_charset, "UTF8");
+        dpbBuilder->insertInt(&status, isc_dpb_force_write, 0);
+        Firebird::AutoRelease<Firebird::IAttachment> att(provider->createDatabase(
+            &status, options.database.c_str(), dpbBuilder->getBufferLength(&status), dpbBuilder->getBuffer(&status)));
+
+        for (const auto& table : planTables(options)) {
+            const auto start = std::chrono::steady_clock::now();
+            execute(&status, att, buildCreateTable(table));
+            execute(&status, att, buildFill(table));
+            const auto end = std::chrono::steady_clock::now();
+            std::cout << table.name << ": " << table.rows << " rows, "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+                << " ms" << std::endl;
+        }
+
+        att->detach(&status);
+        att.release();
+    }
+    catch (const Firebird::FbException& e) {
+        char buffer[2048];
+        util->formatStatus(buffer, static_cast<unsigned int>(sizeof(buffer)), e.getStatus());
+        std::cerr << "Error: " << buffer << std::endl;
+        status.dispose();
+        return 1;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        status.dispose();
+        return 1;
+    }
+    status.dispose();
+    return 0;
+}
@@ -0,0 +1,117 @@
+#!/bin/sh
+# End-to-end benchmark of CSVExport. Fills the database with CSVExportGen and exports it
+# with every --parallel value of the matrix, the best of the repeated runs is taken.
+# The results of the run go to $RESULTS/results.csv, the same lines with the label of
+# the run are appended to $RESULTS/history.csv, so the scaling can be compared over time.
+#
+# Settings (environment):
+#   DATABASE        connection string of the benchmark database, required
+#   FB_USER         user name, default SYSDBA
+#   FB_PASSWORD     password, default masterkey
+#   CSVEXPORT       path of CSVExport, default ./CSVExport
+#   CSVEXPORT_GEN   path of CSVExportGen, default ./CSVExportGen
+#   GENERATE        "no" exports the existing database, default yes
+#   GEN_OPTIONS     options of CSVExportGen, e.g. "--tables 30 --rows 5000000 --skew 1.5 --wide-columns 100"
+#   EXPORT_OPTIONS  more options of CSVExport, e.g. "--pipeline 2 -z zstd"
+#   PARALLEL        --parallel values, default "1 2 4 8". The first one is the base of the efficiency
+#   REPEAT          runs of each value, default 3
+#   WARMUP          runs before the measurement, they fill the page cache, default 1
+#   RESULTS         output directory, default ./bench-results
+#   BENCH_LABEL     label of the run in the history, default is the current time
+
+set -eu
+
+DATABASE=${DATABASE:?the connection string of the benchmark database is required}
+FB_USER=${FB_USER:-SYSDBA}
+FB_PASSWORD=${FB_PASSWORD:-masterkey}
+CSVEXPORT=${CSVEXPORT:-./CSVExport}
+CSVEXPORT_GEN=${CSVEXPORT_GEN:-./CSVExportGen}
+GENERATE=${GENERATE:-yes}
+GEN_OPTIONS=${GEN_OPTIONS:-}
+EXPORT_OPTIONS=${EXPORT_OPTIONS:-}
+PARALLEL=${PARALLEL:-"1 2 4 8"}
+REPEAT=${REPEAT:-3}
+WARMUP=${WARMUP:-1}
+RESULTS=${RESULTS:-./bench-results}
+BENCH_LABEL=${BENCH_LABEL:-$(date -u +%Y-%m-%dT%H:%M:%SZ)}
+
+OUTPUT="$RESULTS/output"
+mkdir -p "$RESULTS"
+
+if [ "$GENERATE" = "yes" ]; then
+    # the server of the container may still be starting
+    attempt=1
+    # shellcheck disable=SC2086
+    until "$CSVEXPORT_GEN" -d "$DATABASE" -u "$FB_USER" -p "$FB_PASSWORD" --recreate $GEN_OPTIONS; do
+        if [ "$attempt" -ge 10 ]; then
+            echo "Error: the benchmark database can not be created" >&2
+            exit 1
+        fi
+        attempt=$((attempt + 1))
+        sleep 3
+    done
+fi
+
+# run_export parallel name: exports the database, the log and the report are kept as $RESULTS/name.*
+run_export() {
+    rm -rf "$OUTPUT"
+    mkdir -p "$OUTPUT"
+    # shellcheck disable=SC2086
+    "$CSVEXPORT" -d "$DATABASE" -u "$FB_USER" -p "$FB_PASSWORD" -o "$OUTPUT" -P "$1" \
+        --report "$RESULTS/$2.json" $EXPORT_OPTIONS > "$RESULTS/$2.log"
+}
+
+first=${PARALLEL%% *}
+i=0
+while [ "$i" -lt "$WARMUP" ]; do
+    run_export "$first" warmup
+    i=$((i + 1))
+done
+
+RUNS="$RESULTS/runs.txt"
+: > "$RUNS"
+for parallel in $PARALLEL; do
+    i=1
+    while [ "$i" -le "$REPEAT" ]; do
+        name="parallel-$parallel-run-$i"
+        run_export "$parallel" "$name"
+        elapsed=$(sed -n 's/^Elapsed time in milliseconds: \([0-9]*\) ms$/\1/p' "$RESULTS/$name.log")
+        bytes=$(sed -n 's/^Bytes written: \([0-9]*\),.*$/\1/p' "$RESULTS/$name.log")
+        rows=$(sed -n 's/^  "rows": \([0-9]*\),$/\1/p' "$RESULTS/$name.json" | head -n 1)
+        if [ -z "$elapsed" ] || [ -z "$rows" ]; then
+            echo "Error: the export with --parallel $parallel has failed, see $RESULTS/$name.log" >&2
+            exit 1
+        fi
+        echo "$parallel $elapsed $rows $bytes" >> "$RUNS"
+        echo "parallel $parallel, run $i: $elapsed ms"
+        i=$((i + 1))
+    done
+done
+rm -rf "$OUTPUT"
+
+# the fastest run of each value, the speedup and the efficiency are relative to the first value
+awk -v label="$BENCH_LABEL" -v results="$RESULTS/results.csv" -v history="$RESULTS/history.csv" '
+    !($1 in best) { order[n++] = $1 }
+    !($1 in best) || $2 < best[$1] { best[$1] = $2; rows[$1] = $3; bytes[$1] = $4 }
+    END {
+        header = "parallel,elapsed_ms,rows,bytes,rows_per_s,mib_per_s,speedup,efficiency"
+        print header > results
+        if ((getline line < history) <= 0) {
+            print "label," header > history
+        }
+        close(history)
+        base = order[0]
+        printf "%10s %12s %14s %12s %9s %11s\n", "parallel", "elapsed ms", "rows/s", "MiB/s", "speedup", "efficiency"
+        for (i = 0; i < n; i++) {
+            p = order[i]
+            seconds = best[p] > 0 ? best[p] / 1000 : 0.001
+            speedup = best[p] > 0 ? best[base] / best[p] : 0
+            efficiency = speedup * base / p
+            line = sprintf("%d,%d,%d,%d,%.0f,%.2f,%.3f,%.3f", p, best[p], rows[p], bytes[p],
+                rows[p] / seconds, bytes[p] / seconds / 1048576, speedup, efficiency)
+            print line > results
+            print label "," line >> history
+            printf "%10d %12d %14.0f %12.2f %9.2f %10.0f%%\n", p, best[p], rows[p] / seconds,
+                bytes[p] / seconds / 1048576, speedup, efficiency * 100
+        }
+    }' "$RUNS"
@@ -20,6 +20,7 @@
  *  Contributor(s): ______________________________________.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -29,17 +30,33 @@
 #include "FBAutoPtr.h"
 #include "CSVFile.h"
 #include "CSVCursorExport.h"
+#include "PartMerger.h"
+#include "CompressSink.h"
+#include "ExportMetrics.h"
 #include <filesystem>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <exception>
 #include <stdexcept>
 #include <chrono>
+#include <list>
+#include <optional>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
 
 namespace fs = std::filesystem;
 
-enum class OptState { NONE, DATABASE, USERNAME, PASSWORD, CHARSET, DIALECT, OUTPUT_DIR, FILTER, SEPARATOR, PARALLEL };
+enum class OptState { NONE, DATABASE, USERNAME, PASSWORD, CHARSET, DIALECT, OUTPUT_DIR, FILTER, SEPARATOR, PARALLEL, BUFFER_SIZE, FLOAT_PRECISION, PIPELINE, MERGE_MEMORY,
+    COMPRESS, COMPRESS_LEVEL, COMPRESS_BLOCK_SIZE, COMPRESS_THREADS, JOB_SIZE, PAGE_SPLIT,
+    SIZE_HINTS, STMT_CACHE, STARTUP_TIMEOUT, BLOB_FORMAT, REPORT, PROGRESS, TRACE, CAPTURE, REPLAY,
+    FORMAT, ROW_GROUP_SIZE };
+
+enum class OutputFormat { CSV, PARQUET, PGCOPY, ROWBINARY };
 
 constexpr char HELP_INFO[] = R"(
 Usage CSVExport [out_dir] <options>
@@ -47,10 +64,40 @@ General options:
     -h [ --help ]                        Show help
     -o [ --output-dir ] path             Output directory
     -H [ --print-header ]                Print CSV header, default false
+    --format format                      Output format: csv, parquet, pgcopy (PostgreSQL COPY BINARY)
+                                         or rowbinary (ClickHouse RowBinary). Default csv
+    --row-group-size size                Size of Parquet row groups in MiB before compression,
+                                         default 64
     -f [ --table-filter ]                Table filter
     -S [ --column-separator ]            Column separator, default ",". Supported: ",", ";" and "t".
                                          Where "t" is '\t'. 
     -P [ --parallel ]                    Parallel threads, default 1
+    --startup-timeout seconds            Time for the parallel threads to attach, default 60
+    -B [ --buffer-size ] size            Output buffer size of each thread in MiB, default 4
+    -J [ --job-size ] size               Size of one export job of a large table: pointer pages,
+                                         estimated bytes with suffix K, M or G, or auto (about 4 jobs
+                                         per thread). Default auto
+    --page-split ranges                  Cut jobs of one pointer page into data page ranges. Default 1
+    --work-stealing                      Idle threads take over the rest of the largest running job
+    --size-hints file                    File with the table sizes of the previous run. Large tables
+                                         are exported first, the file is updated after the export
+    --float-precision digits             Digits after the point for FLOAT and DOUBLE PRECISION.
+                                         By default the shortest exact form is used.
+    --blob-format format                 Text of binary BLOBs: hex or base64. Default hex
+    --pipeline threads                   Formatter threads of each export thread. Fetching,
+                                         formatting and writing run in parallel. Default 0 (disabled)
+    --stmt-cache statements              Prepared statements kept by each export thread, default 16
+    --merge-memory size                  Memory for parts of large tables finished out of order, MiB.
+                                         Default 256
+    -z [ --compress ] method             Compress output files: none, gzip or zstd. Default none
+    --compress-level level               Compression level, default 6 for gzip and 3 for zstd
+    --compress-block-size size           Size of independently compressed blocks in MiB, default 1
+    --compress-threads threads           Compression threads, default is the number of CPU cores
+    --progress seconds                   Print rows/s, MiB/s and ETA every given number of seconds
+    --report file                        Write the counters of every thread and job to a JSON file
+    --trace file                         Write the timeline of the threads in the Chrome trace format
+    --capture dir                        Save the raw fetched messages of every job to the directory
+    --replay dir                         Export the captured messages without the database
 
 Database options:
     -d [ --database ] connection_string  Database connection string
@@ -114,8 +161,403 @@ namespace FBExport
         std::string relation_name;
         int32_t page_sequence;
         int64_t pp_cnt;
+        // records exported by the job
+        PageRange range;
+        // position of the job among the jobs of the table
+        size_t part_number = 0;
+        size_t part_count = 1;
+        // the range is taken from another running job
+        bool stolen = false;
+    };
+
+    // Job taken by a worker. In the work stealing mode its range can be shortened
+    // by idle workers, and the merger part is opened when the job is taken.
+    struct ExportJob
+    {
+        TableDesc desc;
+        std::unique_ptr<SharedRange> range;
+        std::optional<csv::PartMerger::PartSink> sink;
+    };
+
+    // the smallest unscanned range worth opening another cursor
+    constexpr int64_t MIN_STEAL_PAGES = 16;
+
+    // Hands out the planned jobs in order. In the work stealing mode, when they are over,
+    // an idle worker takes the second half of the unscanned range of the largest running job.
+    class JobQueue final
+    {
+    public:
+        using Job = std::list<ExportJob>::iterator;
+    private:
+        const std::vector<TableDesc>& m_jobs;
+        csv::PartMerger& m_merger;
+        const PageGeometry m_geometry;
+        const bool m_stealing;
+        std::mutex m_mutex;
+        size_t m_next = 0;
+        std::list<ExportJob> m_running;
+        bool m_stopped = false;
+    public:
+        JobQueue(const std::vector<TableDesc>& jobs, csv::PartMerger& merger, const PageGeometry& geometry, bool stealing)
+            : m_jobs(jobs)
+            , m_merger(merger)
+            , m_geometry(geometry)
+            , m_stealing(stealing)
+        {}
+
+        // Returns false when there is nothing left to do
+        bool take(Job& job)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped) {
+                return false;
+            }
+            if (m_next < m_jobs.size()) {
+                job = m_running.emplace(m_running.end());
+                job->desc = m_jobs[m_next++];
+                if (m_stealing) {
+                    const auto& range = job->desc.range;
+                    job->range = std::make_unique<SharedRange>(
+                        m_geometry.toRecord(range.lowerPP, range.lowerDP),
+                        m_geometry.toRecord(range.upperPP, range.upperDP),
+                        m_geometry.recordsPerDP);
+                    job->sink.emplace(m_merger.openPart(job->desc.relation_name, job->desc.part_number));
+                }
+                return true;
+            }
+            return m_stealing && steal(job);
+        }
+
+        void release(Job job)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running.erase(job);
+        }
+
+        // After an error the remaining jobs are not handed out
+        void stop()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+    private:
+        bool steal(Job& job)
+        {
+            const int64_t minRecords = MIN_STEAL_PAGES * m_geometry.recordsPerDP;
+            // the owner may finish between the choice and the split, so the next victim is tried
+            while (true) {
+                Job victim = m_running.end();
+                int64_t victimRemaining = minRecords - 1;
+                for (auto it = m_running.begin(); it != m_running.end(); ++it) {
+                    const int64_t remaining = it->range->remaining();
+                    if (remaining > victimRemaining) {
+                        victim = it;
+                        victimRemaining = remaining;
+                    }
+                }
+                if (victim == m_running.end()) {
+                    return false;
+                }
+                ExportJob stolen;
+                stolen.desc = victim->desc;
+                stolen.desc.stolen = true;
+                const bool done = victim->range->split(minRecords, [&](int64_t lower, int64_t upper) {
+                    // the new part follows the victim in the file
+                    stolen.sink.emplace(m_merger.insertAfter(*victim->sink));
+                    stolen.range = std::make_unique<SharedRange>(lower, upper, m_geometry.recordsPerDP);
+                    stolen.desc.range = m_geometry.toPageRange(lower, upper);
+                });
+                if (done) {
+                    job = m_running.insert(m_running.end(), std::move(stolen));
+                    return true;
+                }
+            }
+        }
     };
 
+    // The workers attach to the database and start their transactions at the same time.
+    // All threads wait for each other before exporting, so an attachment error or
+    // a server that does not answer stops the export before any file is written.
+    class StartupLatch final
+    {
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        size_t m_pending;
+        bool m_failed = false;
+    public:
+        explicit StartupLatch(size_t count)
+            : m_pending(count)
+        {}
+
+        // Worker side: waits for the other workers, returns false if the export
+        // is cancelled and the worker must quit
+        bool arrive()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_pending > 0 && --m_pending == 0) {
+                m_cond.notify_all();
+            }
+            // the main thread cancels the start on the timeout
+            m_cond.wait(lock, [this] { return m_pending == 0 || m_failed; });
+            return !m_failed;
+        }
+
+        // Worker side: the worker could not start
+        void fail()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pending > 0) {
+                m_pending--;
+            }
+            m_failed = true;
+            m_cond.notify_all();
+        }
+
+        // Main thread side: true if all workers have started in time. On the timeout
+        // the workers still starting will quit.
+        bool wait(std::chrono::seconds timeout, size_t& pending)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, timeout, [this] { return m_pending == 0 || m_failed; });
+            pending = m_pending;
+            if (m_pending > 0) {
+                m_failed = true;
+                m_cond.notify_all();
+            }
+            return !m_failed;
+        }
+    };
+
+    // Target size of one job of a large table
+    struct JobSize
+    {
+        // pointer pages per job, 0 - not set
+        int64_t pages = 0;
+        // estimated bytes per job, 0 - not set
+        uint64_t bytes = 0;
+    };
+
+    // The pointer page header of Firebird 3+. Each slot of a pointer page is
+    // the number of a data page and a byte of its flags.
+    constexpr unsigned POINTER_PAGE_HEADER = 32;
+    constexpr unsigned POINTER_PAGE_SLOT = 5;
+    constexpr unsigned DEFAULT_PAGE_SIZE = 8192;
+    // jobs per worker in the automatic mode, the spare jobs even out the finish of the threads
+    constexpr int64_t JOBS_PER_WORKER = 4;
+
+    // Settings of the job planner
+    struct JobPlan
+    {
+        JobSize size;
+        int workers = 1;
+        unsigned pageSize = DEFAULT_PAGE_SIZE;
+        // Jobs of one pointer page are cut into this number of data page ranges
+        int64_t pageSplit = 1;
+        PageGeometry geometry;
+    };
+
+    // upper estimate of the data covered by one full pointer page
+    uint64_t getPointerPageBytes(const JobPlan& plan)
+    {
+        const unsigned pageSize = plan.pageSize > POINTER_PAGE_HEADER ? plan.pageSize : DEFAULT_PAGE_SIZE;
+        return static_cast<uint64_t>((pageSize - POINTER_PAGE_HEADER) / POINTER_PAGE_SLOT) * pageSize;
+    }
+
+    int64_t getJobPages(const JobPlan& plan, int64_t ppCount)
+    {
+        if (plan.size.pages > 0) {
+            return plan.size.pages;
+        }
+        if (plan.size.bytes > 0) {
+            return std::max<int64_t>(1, static_cast<int64_t>(plan.size.bytes / getPointerPageBytes(plan)));
+        }
+        // the table is shared evenly between the workers
+        return std::max<int64_t>(1, ppCount / (plan.workers * JOBS_PER_WORKER));
+    }
+
+    // Groups consecutive pointer pages of each table into jobs. When a job gets 
+    // a single pointer page and the split is enabled, the page is cut further
+    // into ranges of data pages.
+    std::vector<TableDesc> planJobs(const std::vector<TableDesc>& pages, const JobPlan& plan)
+    {
+        // every range must contain at least one data page
+        const int64_t pageSplit = std::min(plan.pageSplit, std::max<int64_t>(plan.geometry.dpPerPP, 1));
+        std::vector<TableDesc> jobs;
+        for (size_t first = 0; first < pages.size(); ) {
+            // pointer pages of one table are listed together in the ascending order
+            size_t last = first + 1;
+            while (last < pages.size() && pages[last].releation_id == pages[first].releation_id) {
+                last++;
+            }
+            const int64_t ppCount = static_cast<int64_t>(last - first);
+            const auto jobPages = static_cast<size_t>(getJobPages(plan, ppCount));
+            const int64_t split = jobPages == 1 ? pageSplit : 1;
+            const size_t partCount = (last - first + jobPages - 1) / jobPages * static_cast<size_t>(split);
+            size_t part = 0;
+            for (size_t i = first; i < last; i += jobPages) {
+                const size_t next = std::min(i + jobPages, last);
+                // the range ends where the next job starts
+                const int64_t lowerPP = pages[i].page_sequence;
+                const int64_t upperPP = next < last ? pages[next].page_sequence : pages[last - 1].page_sequence + 1;
+                for (int64_t k = 0; k < split; k++) {
+                    auto& job = jobs.emplace_back(pages[i]);
+                    job.range.lowerPP = lowerPP;
+                    job.range.lowerDP = k * plan.geometry.dpPerPP / split;
+                    if (k + 1 < split) {
+                        job.range.upperPP = lowerPP;
+                        job.range.upperDP = (k + 1) * plan.geometry.dpPerPP / split;
+                    }
+                    else {
+                        job.range.upperPP = upperPP;
+                        job.range.upperDP = 0;
+                    }
+                    job.part_number = part++;
+                    job.part_count = partCount;
+                }
+            }
+            first = last;
+        }
+        return jobs;
+    }
+
+    // Sizes of the tables written by a previous run, bytes by the table name
+    using SizeHints = std::map<std::string, uint64_t>;
+
+    // Each line is the table name and its size separated by a tab
+    SizeHints readSizeHints(const fs::path& path)
+    {
+        SizeHints hints;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            const auto pos = line.rfind('\t');
+            if (pos == std::string::npos || pos == 0) {
+                continue;
+            }
+            try {
+                hints[line.substr(0, pos)] = std::stoull(line.substr(pos + 1));
+            }
+            catch (const std::exception&) {
+                // a broken line only loses its hint
+            }
+        }
+        return hints;
+    }
+
+    void writeSizeHints(const fs::path& path, const SizeHints& hints)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        for (const auto& [name, size] : hints) {
+            out << name << '\t' << size << '\n';
+        }
+        if (!out) {
+            std::cerr << "Warning: can not write size hints to " << path.string() << std::endl;
+        }
+    }
+
+    // Text values are fetched in the connection character set
+    bool isUtf8Charset(const std::string& charset)
+    {
+        std::string name(charset);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        return name == "UTF8" || name == "UNICODE_FSS";
+    }
+
+    // Orders the tables by the estimated size, the largest first, so a huge table 
+    // does not start at the end of the run because of its name. The small tables
+    // left for the end even out the finish of the threads. The size is the size 
+    // from the previous run or an estimate from the number of pointer pages of the 
+    // table; the data pages are not counted. The estimate uses the bytes per pointer 
+    // page of the hinted tables, so it is comparable with their sizes, or the data 
+    // covered by a full pointer page when there are no hints.
+    // The pointer pages of each table stay together in the ascending order.
+    std::vector<TableDesc> orderBySize(const std::vector<TableDesc>& pages, const JobPlan& plan, const SizeHints& hints)
+    {
+        struct Table
+        {
+            size_t first;
+            size_t last;
+            uint64_t size;
+            bool hinted;
+        };
+        std::vector<Table> order;
+        uint64_t hintedBytes = 0;
+        uint64_t hintedPages = 0;
+        for (size_t first = 0; first < pages.size(); ) {
+            size_t last = first + 1;
+            while (last < pages.size() && pages[last].releation_id == pages[first].releation_id) {
+                last++;
+            }
+            auto it = hints.find(pages[first].relation_name);
+            const bool hinted = it != hints.end();
+            if (hinted) {
+                hintedBytes += it->second;
+                hintedPages += last - first;
+            }
+            order.push_back({ first, last, hinted ? it->second : 0, hinted });
+            first = last;
+        }
+        const uint64_t ppBytes = hintedPages > 0 ? hintedBytes / hintedPages : getPointerPageBytes(plan);
+        for (auto& table : order) {
+            if (!table.hinted) {
+                table.size = (table.last - table.first) * ppBytes;
+            }
+        }
+        // the tables of the same size keep the alphabetical order
+        std::stable_sort(order.begin(), order.end(), [](const Table& a, const Table& b) {
+            return a.size > b.size;
+        });
+        std::vector<TableDesc> ret;
+        ret.reserve(pages.size());
+        for (const auto& table : order) {
+            ret.insert(ret.end(), pages.begin() + table.first, pages.begin() + table.last);
+        }
+        return ret;
+    }
+
+    // 0x0112345678, the high byte and the four low bytes of the record number differ
+    constexpr int64_t DBKEY_PROBE = 4600387192;
+
+    // MAKE_DBKEY computes the record number from the page numbers using the server 
+    // constants, so they are read back from the record numbers of the first 
+    // record of the second data page and of the second pointer page. The geometry
+    // is left unknown if a probe key with all bytes different does not decode back,
+    // e.g. on a big-endian server.
+    PageGeometry getPageGeometry(
+        Firebird::ThrowStatusWrapper* status,
+        Firebird::IAttachment* att,
+        Firebird::ITransaction* tra,
+        unsigned int sqlDialect)
+    {
+        const std::string sql = "SELECT MAKE_DBKEY(0, 0, 1, 0), MAKE_DBKEY(0, 0, 0, 1), MAKE_DBKEY(0, "
+            + std::to_string(DBKEY_PROBE) + ") FROM RDB$DATABASE";
+        Firebird::AutoRelease<Firebird::IStatement> stmt(att->prepare(
+            status,
+            tra,
+            0,
+            sql.c_str(),
+            sqlDialect,
+            Firebird::IStatement::PREPARE_PREFETCH_METADATA
+        ));
+        Firebird::AutoRelease<Firebird::IMessageMetadata> meta(stmt->getOutputMetadata(status));
+        std::vector<unsigned char> buffer(meta->getMessageLength(status));
+        Firebird::AutoRelease<Firebird::IResultSet> rs(stmt->openCursor(status, tra, nullptr, nullptr, meta, 0));
+
+        PageGeometry ret;
+        if (rs->fetchNext(status, buffer.data()) == Firebird::IStatus::RESULT_OK) {
+            const int64_t recordsPerDP = decodeDbKey(buffer.data() + meta->getOffset(status, 0));
+            const int64_t recordsPerPP = decodeDbKey(buffer.data() + meta->getOffset(status, 1));
+            const int64_t probe = decodeDbKey(buffer.data() + meta->getOffset(status, 2));
+            if (recordsPerDP > 0 && probe == DBKEY_PROBE) {
+                ret.recordsPerDP = recordsPerDP;
+                ret.dpPerPP = recordsPerPP / recordsPerDP;
+            }
+        }
+        rs->close(status);
+        rs.release();
+
+        return ret;
+    }
 
     std::vector<TableDesc> getTablesDesc(
         Firebird::ThrowStatusWrapper* status,
@@ -201,13 +643,62 @@ namespace FBExport
         return ret;
     }
 
+    std::string getErrorMessage(const Firebird::FbException& e)
+    {
+        char buffer[2048];
+        fb_master->getUtilInterface()->formatStatus(buffer, static_cast<unsigned int>(std::size(buffer)), e.getStatus());
+        return buffer;
+    }
+
+    unsigned getPageSize(Firebird::ThrowStatusWrapper* status, Firebird::IAttachment* att)
+    {
+        unsigned ret = 0;
+        unsigned char in_buf[] = { isc_info_page_size, isc_info_end };
+        unsigned char out_buf[16] = { 0 };
+
+        att->getInfo(status, sizeof(in_buf), in_buf, sizeof(out_buf), out_buf);
+
+        auto fb_util = fb_master->getUtilInterface();
+        Firebird::AutoDispose<Firebird::IXpbBuilder> xpbParser(
+            fb_util->getXpbBuilder(status, Firebird::IXpbBuilder::INFO_RESPONSE, out_buf, sizeof(out_buf))
+        );
+
+        if (xpbParser->findFirst(status, isc_info_page_size)) {
+            ret = static_cast<unsigned>(xpbParser->getInt(status));
+        }
+
+        return ret;
+    }
+
     class ExportApp final
     {
         fs::path m_outputDir;
         std::string m_filter;
         std::string m_separator{","};
         int m_parallel = 1;
+        JobSize m_jobSize;
+        int64_t m_pageSplit = 1;
+        size_t m_stmtCacheSize = FBExport::DEFAULT_STATEMENT_CACHE_SIZE;
+        std::chrono::seconds m_startupTimeout{ 60 };
+        bool m_workStealing = false;
+        fs::path m_sizeHints;
+        fs::path m_report;
+        fs::path m_trace;
+        fs::path m_captureDir;
+        fs::path m_replayDir;
+        std::chrono::seconds m_progressInterval{ 0 };
+        size_t m_bufferSize = csv::DEFAULT_BUFFER_SIZE;
+        FBExport::FormatOptions m_formatOptions;
+        unsigned m_formatThreads = 0;
+        size_t m_mergeMemory = csv::DEFAULT_MERGE_MEMORY;
+        csv::Compression m_compression = csv::Compression::NONE;
+        int m_compressLevel = 0;
+        size_t m_compressBlockSize = csv::DEFAULT_COMPRESS_BLOCK_SIZE;
+        unsigned m_compressThreads = std::thread::hardware_concurrency();
+        std::unique_ptr<csv::CompressorPool> m_compressorPool;
         bool m_printHeader = false;
+        OutputFormat m_outputFormat = OutputFormat::CSV;
+        FBExport::ParquetOptions m_parquetOptions;
         // database options
         std::string m_database;
         std::string m_username;
@@ -225,15 +716,116 @@ namespace FBExport
 
         int exportData();
 
-        void exportByTableDesc(Firebird::ThrowStatusWrapper* status, FBExport::CSVExportTable& csvExport, const TableDesc& tableDesc);
+        // Exports the capture directory, the tables are taken from the capture files
+        int replayData();
+
+        void reportRun(
+            ExportMetrics& metrics,
+            const csv::WriteStats& writeStats,
+            const BlobStats& blobStats,
+            std::chrono::steady_clock::time_point start);
+
+        // The counters of the job are added to the metrics of the run
+        void exportByTableDesc(
+            Firebird::ThrowStatusWrapper* status, 
+            FBExport::CSVExportTable& csvExport, 
+            ExportJob& job, 
+            csv::OutputBuffer& buffer,
+            csv::PartMerger* merger,
+            ExportMetrics& metrics,
+            unsigned worker);
+
+        void exportToSink(
+            Firebird::ThrowStatusWrapper* status,
+            FBExport::CSVExportTable& csvExport,
+            ExportJob& job,
+            csv::OutputBuffer& buffer,
+            csv::OutputSink& sink,
+            JobMetrics& jobMetrics,
+            FBExport::RowSource* replay,
+            bool wholeFile);
+
+        // Writes the job to a Parquet file of its own
+        void exportToParquet(
+            Firebird::ThrowStatusWrapper* status,
+            FBExport::CSVExportTable& csvExport,
+            ExportJob& job,
+            csv::OutputBuffer& buffer,
+            JobMetrics& jobMetrics,
+            FBExport::RowSource* replay);
+
+        fs::path getOutputPath(const std::string& relationName) const
+        {
+            return m_outputDir / (relationName + FBExport::binaryExtension(binaryFormat()) + csv::compressionExtension(m_compression));
+        }
+
+        FBExport::BinaryFormat binaryFormat() const
+        {
+            switch (m_outputFormat) {
+            case OutputFormat::PGCOPY:
+                return FBExport::BinaryFormat::PGCOPY;
+            case OutputFormat::ROWBINARY:
+                return FBExport::BinaryFormat::ROWBINARY;
+            default:
+                return FBExport::BinaryFormat::NONE;
+            }
+        }
+
+        // The header or the trailer of a merged file in the form of the compressed blocks
+        std::string getFileFraming(std::string_view data) const;
+
+        // The parts of a table are the files of the table directory, as Spark and Hive expect them
+        fs::path getParquetPath(const std::string& relationName, size_t partNumber) const
+        {
+            char fileName[32];
+            std::snprintf(fileName, sizeof(fileName), "part-%05zu.parquet", partNumber);
+            return m_outputDir / relationName / fileName;
+        }
 
         void parseArgs(int argc, const char** argv);
+
+        void setBufferSize(const std::string& value);
+
+        void setFloatPrecision(const std::string& value);
+
+        void setBlobFormat(const std::string& value);
+
+        void setOutputFormat(const std::string& value);
+
+        void setRowGroupSize(const std::string& value);
+
+        void setFormatThreads(const std::string& value);
+
+        void setMergeMemory(const std::string& value);
+
+        void setJobSize(const std::string& value);
+
+        void setPageSplit(const std::string& value);
+
+        void setStmtCacheSize(const std::string& value);
+
+        void setStartupTimeout(const std::string& value);
+
+        void setProgressInterval(const std::string& value);
+
+        void setCompression(const std::string& value);
+
+        void setCompressLevel(const std::string& value);
+
+        void setCompressBlockSize(const std::string& value);
+
+        void setCompressThreads(const std::string& value);
     };
 
     int ExportApp::exec(int argc, const char** argv)
     {
         parseArgs(argc, argv);
-        exportData();
+        if (!m_replayDir.empty()) {
+            replayData();
+        }
+        else {
+            exportData();
+        }
         return 0;
     }
 
@@ -269,6 +861,15 @@ namespace FBExport
                 case 'P':
                     st = OptState::PARALLEL;
                     break;
+                case 'B':
+                    st = OptState::BUFFER_SIZE;
+                    break;
+                case 'z':
+                    st = OptState::COMPRESS;
+                    break;
+                case 'J':
+                    st = OptState::JOB_SIZE;
+                    break;
                 case 'd':
                     st = OptState::DATABASE;
                     break;
@@ -316,6 +917,94 @@ namespace FBExport
                     st = OptState::PARALLEL;
                     continue;
                 }
+                if (arg == "--buffer-size") {
+                    st = OptState::BUFFER_SIZE;
+                    continue;
+                }
+                if (arg == "--blob-format") {
+                    st = OptState::BLOB_FORMAT;
+                    continue;
+                }
+                if (arg == "--format") {
+                    st = OptState::FORMAT;
+                    continue;
+                }
+                if (arg == "--row-group-size") {
+                    st = OptState::ROW_GROUP_SIZE;
+                    continue;
+                }
+                if (arg == "--float-precision") {
+                    st = OptState::FLOAT_PRECISION;
+                    continue;
+                }
+                if (arg == "--pipeline") {
+                    st = OptState::PIPELINE;
+                    continue;
+                }
+                if (arg == "--merge-memory") {
+                    st = OptState::MERGE_MEMORY;
+                    continue;
+                }
+                if (arg == "--job-size") {
+                    st = OptState::JOB_SIZE;
+                    continue;
+                }
+                if (arg == "--work-stealing") {
+                    m_workStealing = true;
+                    continue;
+                }
+                if (arg == "--size-hints") {
+                    st = OptState::SIZE_HINTS;
+                    continue;
+                }
+                if (arg == "--report") {
+                    st = OptState::REPORT;
+                    continue;
+                }
+                if (arg == "--progress") {
+                    st = OptState::PROGRESS;
+                    continue;
+                }
+                if (arg == "--trace") {
+                    st = OptState::TRACE;
+                    continue;
+                }
+                if (arg == "--capture") {
+                    st = OptState::CAPTURE;
+                    continue;
+                }
+                if (arg == "--replay") {
+                    st = OptState::REPLAY;
+                    continue;
+                }
+                if (arg == "--startup-timeout") {
+                    st = OptState::STARTUP_TIMEOUT;
+                    continue;
+                }
+                if (arg == "--stmt-cache") {
+                    st = OptState::STMT_CACHE;
+                    continue;
+                }
+                if (arg == "--page-split") {
+                    st = OptState::PAGE_SPLIT;
+                    continue;
+                }
+                if (arg == "--compress") {
+                    st = OptState::COMPRESS;
+                    continue;
+                }
+                if (arg == "--compress-level") {
+                    st = OptState::COMPRESS_LEVEL;
+                    continue;
+                }
+                if (arg == "--compress-block-size") {
+                    st = OptState::COMPRESS_BLOCK_SIZE;
+                    continue;
+                }
+                if (arg == "--compress-threads") {
+                    st = OptState::COMPRESS_THREADS;
+                    continue;
+                }
                 if (arg == "--database") {
                     st = OptState::DATABASE;
                     continue;
@@ -374,59 +1063,143 @@ namespace FBExport
                     }
                     continue;
                 }
-                if (auto pos = arg.find("--database="); pos == 0) {
-                    m_database.assign(arg.substr(11));
+                if (auto pos = arg.find("--buffer-size="); pos == 0) {
+                    setBufferSize(arg.substr(14));
                     continue;
                 }
-                if (auto pos = arg.find("--username="); pos == 0) {
-                    m_username.assign(arg.substr(11));
+                if (auto pos = arg.find("--blob-format="); pos == 0) {
+                    setBlobFormat(arg.substr(14));
                     continue;
                 }
-                if (auto pos = arg.find("--password="); pos == 0) {
-                    m_password.assign(arg.substr(11));
+                if (auto pos = arg.find("--format="); pos == 0) {
+                    setOutputFormat(arg.substr(9));
                     continue;
                 }
-                if (auto pos = arg.find("--charset="); pos == 0) {
-                    m_charset.assign(arg.substr(10));
+                if (auto pos = arg.find("--row-group-size="); pos == 0) {
+                    setRowGroupSize(arg.substr(17));
                     continue;
                 }
-                if (auto pos = arg.find("--sql-dialect="); pos == 0) {
-                    std::string sql_dialect = arg.substr(14);
-                    m_sqlDialect = static_cast<unsigned short>(std::stoi(sql_dialect));
-                    if (m_sqlDialect != 1 && m_sqlDialect != 3) {
-                        std::cerr << "Error: sql_dialect must be 1 or 3" << std::endl;
-                        exit(-1);
-                    }
+                if (auto pos = arg.find("--float-precision="); pos == 0) {
+                    setFloatPrecision(arg.substr(18));
                     continue;
                 }
-                std::cerr << "Error: unrecognized option '" << arg << "'. See: --help" << std::endl;
-                exit(-1);
-            }
-            else {
-                if (i == 1) {
-                    m_outputDir.assign(arg);
+                if (auto pos = arg.find("--pipeline="); pos == 0) {
+                    setFormatThreads(arg.substr(11));
                     continue;
                 }
-                switch (st) {
-                case OptState::OUTPUT_DIR:
-                    m_outputDir.assign(arg);
-                    break;
-                case OptState::FILTER:
-                    m_filter.assign(arg);
-                    break;
-                case OptState::SEPARATOR:
-                    m_separator.assign(arg);
-                    if (m_separator.length() > 1) {
-                        std::cerr << "Error: invalid separator" << std::endl;
-                        exit(-1);
-                    }
-                    else {
-                        switch (m_separator[0]) {
-                        case ',':
-                        case ';':
-                            break;
-                        case 't':
-                            m_separator = "\t";
+                if (auto pos = arg.find("--merge-memory="); pos == 0) {
+                    setMergeMemory(arg.substr(15));
+                    continue;
+                }
+                if (auto pos = arg.find("--job-size="); pos == 0) {
+                    setJobSize(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--size-hints="); pos == 0) {
+                    m_sizeHints.assign(arg.substr(13));
+                    continue;
+                }
+                if (auto pos = arg.find("--report="); pos == 0) {
+                    m_report.assign(arg.substr(9));
+                    continue;
+                }
+                if (auto pos = arg.find("--progress="); pos == 0) {
+                    setProgressInterval(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--trace="); pos == 0) {
+                    m_trace.assign(arg.substr(8));
+                    continue;
+                }
+                if (auto pos = arg.find("--capture="); pos == 0) {
+                    m_captureDir.assign(arg.substr(10));
+                    continue;
+                }
+                if (auto pos = arg.find("--replay="); pos == 0) {
+                    m_replayDir.assign(arg.substr(9));
+                    continue;
+                }
+                if (auto pos = arg.find("--startup-timeout="); pos == 0) {
+                    setStartupTimeout(arg.substr(18));
+                    continue;
+                }
+                if (auto pos = arg.find("--stmt-cache="); pos == 0) {
+                    setStmtCacheSize(arg.substr(13));
+                    continue;
+                }
+                if (auto pos = arg.find("--page-split="); pos == 0) {
+                    setPageSplit(arg.substr(13));
+                    continue;
+                }
+                if (auto pos = arg.find("--compress="); pos == 0) {
+                    setCompression(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--compress-level="); pos == 0) {
+                    setCompressLevel(arg.substr(17));
+                    continue;
+                }
+                if (auto pos = arg.find("--compress-block-size="); pos == 0) {
+                    setCompressBlockSize(arg.substr(22));
+                    continue;
+                }
+                if (auto pos = arg.find("--compress-threads="); pos == 0) {
+                    setCompressThreads(arg.substr(19));
+                    continue;
+                }
+                if (auto pos = arg.find("--database="); pos == 0) {
+                    m_database.assign(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--username="); pos == 0) {
+                    m_username.assign(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--password="); pos == 0) {
+                    m_password.assign(arg.substr(11));
+                    continue;
+                }
+                if (auto pos = arg.find("--charset="); pos == 0) {
+                    m_charset.assign(arg.substr(10));
+                    continue;
+                }
+                if (auto pos = arg.find("--sql-dialect="); pos == 0) {
+                    std::string sql_dialect = arg.substr(14);
+                    m_sqlDialect = static_cast<unsigned short>(std::stoi(sql_dialect));
+                    if (m_sqlDialect != 1 && m_sqlDialect != 3) {
+                        std::cerr << "Error: sql_dialect must be 1 or 3" << std::endl;
+                        exit(-1);
+                    }
+                    continue;
+                }
+                std::cerr << "Error: unrecognized option '" << arg << "'. See: --help" << std::endl;
+                exit(-1);
+            }
+            else {
+                if (i == 1) {
+                    m_outputDir.assign(arg);
+                    continue;
+                }
+                switch (st) {
+                case OptState::OUTPUT_DIR:
+                    m_outputDir.assign(arg);
+                    break;
+                case OptState::FILTER:
+                    m_filter.assign(arg);
+                    break;
+                case OptState::SEPARATOR:
+                    m_separator.assign(arg);
+                    if (m_separator.length() > 1) {
+                        std::cerr << "Error: invalid separator" << std::endl;
+                        exit(-1);
+                    }
+                    else {
+                        switch (m_separator[0]) {
+                        case ',':
+                        case ';':
+                            break;
+                        case 't':
+                            m_separator = "\t";
                             break;
                         default:
                             std::cerr << "Error: invalid separator" << std::endl;
@@ -441,6 +1214,69 @@ namespace FBExport
                         exit(-1);
                     }
                     break;
+                case OptState::BUFFER_SIZE:
+                    setBufferSize(arg);
+                    break;
+                case OptState::BLOB_FORMAT:
+                    setBlobFormat(arg);
+                    break;
+                case OptState::FORMAT:
+                    setOutputFormat(arg);
+                    break;
+                case OptState::ROW_GROUP_SIZE:
+                    setRowGroupSize(arg);
+                    break;
+                case OptState::FLOAT_PRECISION:
+                    setFloatPrecision(arg);
+                    break;
+                case OptState::PIPELINE:
+                    setFormatThreads(arg);
+                    break;
+                case OptState::MERGE_MEMORY:
+                    setMergeMemory(arg);
+                    break;
+                case OptState::JOB_SIZE:
+                    setJobSize(arg);
+                    break;
+                case OptState::SIZE_HINTS:
+                    m_sizeHints.assign(arg);
+                    break;
+                case OptState::REPORT:
+                    m_report.assign(arg);
+                    break;
+                case OptState::PROGRESS:
+                    setProgressInterval(arg);
+                    break;
+                case OptState::TRACE:
+                    m_trace.assign(arg);
+                    break;
+                case OptState::CAPTURE:
+                    m_captureDir.assign(arg);
+                    break;
+                case OptState::REPLAY:
+                    m_replayDir.assign(arg);
+                    break;
+                case OptState::STARTUP_TIMEOUT:
+                    setStartupTimeout(arg);
+                    break;
+                case OptState::STMT_CACHE:
+                    setStmtCacheSize(arg);
+                    break;
+                case OptState::PAGE_SPLIT:
+                    setPageSplit(arg);
+                    break;
+                case OptState::COMPRESS:
+                    setCompression(arg);
+                    break;
+                case OptState::COMPRESS_LEVEL:
+                    setCompressLevel(arg);
+                    break;
+                case OptState::COMPRESS_BLOCK_SIZE:
+                    setCompressBlockSize(arg);
+                    break;
+                case OptState::COMPRESS_THREADS:
+                    setCompressThreads(arg);
+                    break;
                 case OptState::DATABASE:
                     m_database.assign(arg);
                     break;
@@ -469,24 +1305,390 @@ namespace FBExport
             std::cerr << "Error: the option '--output-dir' is required but missing" << std::endl;
             exit(-1);
         }
+        if (m_compression == csv::Compression::GZIP && m_compressLevel > 9) {
+            std::cerr << "Error: gzip compression level must be between 1 and 9" << std::endl;
+            exit(-1);
+        }
+        if (!m_captureDir.empty() && !m_replayDir.empty()) {
+            std::cerr << "Error: the options '--capture' and '--replay' can not be used together" << std::endl;
+            exit(-1);
+        }
+        // a stolen range has no file of its own, so every job must keep its range
+        if (m_workStealing && (!m_captureDir.empty() || !m_replayDir.empty())) {
+            std::cerr << "Warning: work stealing is disabled for the capture and the replay" << std::endl;
+            m_workStealing = false;
+        }
+        if (m_outputFormat == OutputFormat::PARQUET) {
+            // every job writes a file of its own, a stolen range would need one more
+            if (m_workStealing) {
+                std::cerr << "Warning: work stealing is disabled for the Parquet output" << std::endl;
+                m_workStealing = false;
+            }
+            // the pages are compressed by the codec of the file, not by the compressor threads
+            m_parquetOptions.compression = m_compression;
+            m_parquetOptions.compressLevel = m_compressLevel;
+            m_parquetOptions.utf8 = isUtf8Charset(m_charset);
+        }
+    }
+
+    void ExportApp::setBufferSize(const std::string& value)
+    {
+        int bufferSize = std::stoi(value);
+        if (bufferSize <= 0 || bufferSize > 1024) {
+            std::cerr << "Error: buffer size must be between 1 and 1024 MiB" << std::endl;
+            exit(-1);
+        }
+        m_bufferSize = static_cast<size_t>(bufferSize) * csv::MIB;
+    }
+
+    void ExportApp::setFloatPrecision(const std::string& value)
+    {
+        int precision = std::stoi(value);
+        if (precision < 0 || precision > 30) {
+            std::cerr << "Error: float precision must be between 0 and 30" << std::endl;
+            exit(-1);
+        }
+        m_formatOptions.floatPrecision = precision;
+    }
+
+    void ExportApp::setFormatThreads(const std::string& value)
+    {
+        int formatThreads = std::stoi(value);
+        if (formatThreads < 0 || formatThreads > 64) {
+            std::cerr << "Error: pipeline threads must be between 0 and 64" << std::endl;
+            exit(-1);
+        }
+        m_formatThreads = static_cast<unsigned>(formatThreads);
+    }
+
+    void ExportApp::setMergeMemory(const std::string& value)
+    {
+        int mergeMemory = std::stoi(value);
+        if (mergeMemory <= 0 || mergeMemory > 65536) {
+            std::cerr << "Error: merge memory must be between 1 and 65536 MiB" << std::endl;
+            exit(-1);
+        }
+        m_mergeMemory = static_cast<size_t>(mergeMemory) * csv::MIB;
+    }
+
+    void ExportApp::setJobSize(const std::string& value)
+    {
+        m_jobSize = JobSize();
+        if (value == "auto") {
+            return;
+        }
+        size_t pos = 0;
+        long long size = std::stoll(value, &pos);
+        if (size <= 0) {
+            std::cerr << "Error: job size must be greater than 0" << std::endl;
+            exit(-1);
+        }
+        const std::string suffix = value.substr(pos);
+        if (suffix.empty()) {
+            m_jobSize.pages = size;
+        }
+        else if (suffix == "K" || suffix == "k") {
+            m_jobSize.bytes = static_cast<uint64_t>(size) << 10;
+        }
+        else if (suffix == "M" || suffix == "m") {
+            m_jobSize.bytes = static_cast<uint64_t>(size) << 20;
+        }
+        else if (suffix == "G" || suffix == "g") {
+            m_jobSize.bytes = static_cast<uint64_t>(size) << 30;
+        }
+        else {
+            std::cerr << "Error: job size must be a number of pages, a size with suffix K, M or G, or auto" << std::endl;
+            exit(-1);
+        }
+    }
+
+    void ExportApp::setPageSplit(const std::string& value)
+    {
+        int pageSplit = std::stoi(value);
+        if (pageSplit <= 0 || pageSplit > 1024) {
+            std::cerr << "Error: page split must be between 1 and 1024" << std::endl;
+            exit(-1);
+        }
+        m_pageSplit = pageSplit;
+    }
+
+    void ExportApp::setStmtCacheSize(const std::string& value)
+    {
+        int cacheSize = std::stoi(value);
+        if (cacheSize <= 0 || cacheSize > 1024) {
+            std::cerr << "Error: statement cache size must be between 1 and 1024" << std::endl;
+            exit(-1);
+        }
+        m_stmtCacheSize = static_cast<size_t>(cacheSize);
+    }
+
+    void ExportApp::setStartupTimeout(const std::string& value)
+    {
+        int timeout = std::stoi(value);
+        if (timeout <= 0 || timeout > 3600) {
+            std::cerr << "Error: startup timeout must be between 1 and 3600 seconds" << std::endl;
+            exit(-1);
+        }
+        m_startupTimeout = std::chrono::seconds(timeout);
+    }
+
+    void ExportApp::setProgressInterval(const std::string& value)
+    {
+        int interval = std::stoi(value);
+        if (interval <= 0 || interval > 3600) {
+            std::cerr << "Error: progress interval must be between 1 and 3600 seconds" << std::endl;
+            exit(-1);
+        }
+        m_progressInterval = std::chrono::seconds(interval);
+    }
+
+    void ExportApp::setOutputFormat(const std::string& value)
+    {
+        if (value == "csv") {
+            m_outputFormat = OutputFormat::CSV;
+        }
+        else if (value == "parquet") {
+            m_outputFormat = OutputFormat::PARQUET;
+        }
+        else if (value == "pgcopy") {
+            m_outputFormat = OutputFormat::PGCOPY;
+        }
+        else if (value == "rowbinary") {
+            m_outputFormat = OutputFormat::ROWBINARY;
+        }
+        else {
+            std::cerr << "Error: output format must be csv, parquet, pgcopy or rowbinary" << std::endl;
+            exit(-1);
+        }
     }
 
-    void ExportApp::exportByTableDesc(Firebird::ThrowStatusWrapper* status, FBExport::CSVExportTable& csvExport, const TableDesc& tableDesc)
+    void ExportApp::setRowGroupSize(const std::string& value)
     {
+        int rowGroupSize = std::stoi(value);
+        if (rowGroupSize <= 0 || rowGroupSize > 1024) {
+            std::cerr << "Error: row group size must be between 1 and 1024 MiB" << std::endl;
+            exit(-1);
+        }
+        m_parquetOptions.rowGroupSize = static_cast<size_t>(rowGroupSize) * csv::MIB;
+    }
+
+    void ExportApp::setBlobFormat(const std::string& value)
+    {
+        try {
+            m_formatOptions.blobEncoding = FBExport::parseBlobEncoding(value);
+        }
+        catch (const std::invalid_argument&) {
+            std::cerr << "Error: BLOB format must be hex or base64" << std::endl;
+            exit(-1);
+        }
+    }
+
+    void ExportApp::setCompression(const std::string& value)
+    {
+        try {
+            m_compression = csv::parseCompression(value);
+        }
+        catch (const std::invalid_argument&) {
+            std::cerr << "Error: compression must be none, gzip or zstd" << std::endl;
+            exit(-1);
+        }
+        if (!csv::isCompressionSupported(m_compression)) {
+            std::cerr << "Error: compression " << value << " is not supported by this build" << std::endl;
+            exit(-1);
+        }
+    }
+
+    void ExportApp::setCompressLevel(const std::string& value)
+    {
+        m_compressLevel = std::stoi(value);
+        if (m_compressLevel <= 0 || m_compressLevel > 22) {
+            std::cerr << "Error: compression level must be between 1 and 22" << std::endl;
+            exit(-1);
+        }
+    }
+
+    void ExportApp::setCompressBlockSize(const std::string& value)
+    {
+        int blockSize = std::stoi(value);
+        if (blockSize <= 0 || blockSize > 256) {
+            std::cerr << "Error: compression block size must be between 1 and 256 MiB" << std::endl;
+            exit(-1);
+        }
+        m_compressBlockSize = static_cast<size_t>(blockSize) * csv::MIB;
+    }
+
+    void ExportApp::setCompressThreads(const std::string& value)
+    {
+        int threads = std::stoi(value);
+        if (threads < 0 || threads > 256) {
+            std::cerr << "Error: compression threads must be between 0 and 256" << std::endl;
+            exit(-1);
+        }
+        m_compressThreads = static_cast<unsigned>(threads);
+    }
+
+    void ExportApp::exportByTableDesc(
+        Firebird::ThrowStatusWrapper* status, 
+        FBExport::CSVExportTable& csvExport, 
+        ExportJob& job, 
+        csv::OutputBuffer& buffer,
+        csv::PartMerger* merger,
+        ExportMetrics& metrics,
+        unsigned worker)
+    {
+        const auto& tableDesc = job.desc;
+        JobMetrics jobMetrics;
+        jobMetrics.table = tableDesc.relation_name;
+        jobMetrics.pageSequence = tableDesc.page_sequence;
+        jobMetrics.part = tableDesc.part_number;
+        jobMetrics.stolen = tableDesc.stolen;
+        jobMetrics.worker = worker;
+        jobMetrics.startTime = metrics.elapsed();
+        const uint64_t startBytes = buffer.written();
+        const auto startWriteTime = buffer.writeTime();
+
         // If the number of PP pages is greater than 1, then it is a large table.To extract data from it, 
         // a SQL query is built with a division into RDB$DB_KEY ranges.
-        bool withDbKeyFilter = tableDesc.pp_cnt > 1;
-        csvExport.prepare(status, tableDesc.relation_name, m_sqlDialect, withDbKeyFilter);
-        std::string fileName = tableDesc.relation_name + ".csv";
-        // If this is not the first part of the page, then the file is temporary; the extension ".partN" is added to it.
-        if (tableDesc.page_sequence > 0) {
-            fileName += ".part_" + std::to_string(tableDesc.page_sequence);
-        }
-        csv::CSVFile csv(m_outputDir / fileName);
-        if (tableDesc.page_sequence == 0 && m_printHeader) {
+        // In the work stealing mode every table is exported by ranges.
+        bool withDbKeyFilter = tableDesc.part_count > 1 || job.range;
+        // the captured messages of the job are exported in the format saved with them
+        std::optional<CaptureReader> replay;
+        std::optional<CaptureWriter> capture;
+        if (!m_replayDir.empty()) {
+            replay.emplace(getCapturePath(m_replayDir, tableDesc.relation_name, tableDesc.part_number));
+            csvExport.prepare(replay->header());
+        }
+        else {
+            csvExport.prepare(status, tableDesc.relation_name, m_sqlDialect, withDbKeyFilter);
+            if (!m_captureDir.empty()) {
+                CaptureHeader header;
+                header.tableName = tableDesc.relation_name;
+                header.pageSequence = tableDesc.page_sequence;
+                header.partNumber = tableDesc.part_number;
+                header.partCount = tableDesc.part_count;
+                header.pointerPages = tableDesc.pp_cnt;
+                capture.emplace(getCapturePath(m_captureDir, tableDesc.relation_name, tableDesc.part_number), header);
+            }
+        }
+        csvExport.setCapture(capture ? &*capture : nullptr);
+        jobMetrics.prepareTime = metrics.elapsed() - jobMetrics.startTime;
+        metrics.addSpan("prepare", worker, jobMetrics.startTime);
+        const auto fetchStart = metrics.elapsed();
+        if (m_outputFormat == OutputFormat::PARQUET) {
+            exportToParquet(status, csvExport, job, buffer, jobMetrics, replay ? &*replay : nullptr);
+            metrics.addSpan("fetch", worker, fetchStart);
+        }
+        else if (!withDbKeyFilter) {
+            csv::FileSink file(getOutputPath(tableDesc.relation_name), buffer.stats());
+            exportToSink(status, csvExport, job, buffer, file, jobMetrics, replay ? &*replay : nullptr, true);
+            file.close();
+            metrics.addSpan("fetch", worker, fetchStart);
+        }
+        else {
+            // Each part of a large table is streamed into the common file in the page order
+            if (!job.sink) {
+                job.sink.emplace(merger->openPart(tableDesc.relation_name, tableDesc.part_number));
+            }
+            exportToSink(status, csvExport, job, buffer, *job.sink, jobMetrics, replay ? &*replay : nullptr, false);
+            metrics.addSpan("fetch", worker, fetchStart);
+            // no part can be cut from this job after it is closed in the merger
+            if (job.range) {
+                job.range->finish();
+            }
+            jobMetrics.mergeWaitTime = job.sink->waitTime();
+            // the head part writes the finished parts after it to the file
+            const auto mergeStart = metrics.elapsed();
+            job.sink->close();
+            jobMetrics.mergeTime = metrics.elapsed() - mergeStart;
+            metrics.addSpan("merge", worker, mergeStart);
+        }
+
+        if (capture) {
+            csvExport.setCapture(nullptr);
+            capture->close();
+        }
+
+        jobMetrics.bytes = buffer.written() - startBytes;
+        jobMetrics.writeTime = buffer.writeTime() - startWriteTime;
+        jobMetrics.totalTime = metrics.elapsed() - jobMetrics.startTime;
+        metrics.addJob(jobMetrics);
+    }
+
+    void ExportApp::exportToSink(
+        Firebird::ThrowStatusWrapper* status,
+        FBExport::CSVExportTable& csvExport,
+        ExportJob& job,
+        csv::OutputBuffer& buffer,
+        csv::OutputSink& sink,
+        JobMetrics& jobMetrics,
+        FBExport::RowSource* replay,
+        bool wholeFile)
+    {
+        const auto& tableDesc = job.desc;
+        const auto format = binaryFormat();
+        // Compressed blocks are self-contained, so the parts of a table 
+        // are joined by the merger without recompression.
+        std::unique_ptr<csv::CompressSink> compressSink;
+        if (m_compressorPool) {
+            compressSink = std::make_unique<csv::CompressSink>(sink, *m_compressorPool);
+        }
+        csv::CSVFile csv(compressSink ? *compressSink : sink, buffer, m_separator);
+        // the merger writes the header and the trailer of the binary formats around the parts
+        if (wholeFile) {
+            const auto header = FBExport::binaryHeader(format);
+            buffer.append(header.data(), header.size());
+        }
+        if (tableDesc.part_number == 0 && !tableDesc.stolen && m_printHeader && format == FBExport::BinaryFormat::NONE) {
             csvExport.printHeader(status, csv);
         }
-        csvExport.printData(status, csv, tableDesc.page_sequence);
+        if (replay) {
+            csvExport.printRows(status, csv, *replay, &jobMetrics);
+        }
+        else {
+            csvExport.printData(status, csv, tableDesc.range, job.range.get(), &jobMetrics);
+        }
+        if (wholeFile) {
+            const auto trailer = FBExport::binaryTrailer(format);
+            buffer.append(trailer.data(), trailer.size());
+        }
+        csv.close();
+        if (compressSink) {
+            compressSink->close();
+        }
+    }
+
+    std::string ExportApp::getFileFraming(std::string_view data) const
+    {
+        if (data.empty() || m_compression == csv::Compression::NONE) {
+            return std::string(data);
+        }
+        // a gzip member or a zstd frame of its own, the file stays a valid stream
+        std::vector<char> block;
+        csv::compressBlock(m_compression, m_compressLevel, data.data(), data.size(), block);
+        return std::string(block.begin(), block.end());
+    }
+
+    void ExportApp::exportToParquet(
+        Firebird::ThrowStatusWrapper* status,
+        FBExport::CSVExportTable& csvExport,
+        ExportJob& job,
+        csv::OutputBuffer& buffer,
+        JobMetrics& jobMetrics,
+        FBExport::RowSource* replay)
+    {
+        const auto& tableDesc = job.desc;
+        const fs::path path = getParquetPath(tableDesc.relation_name, tableDesc.part_number);
+        fs::create_directories(path.parent_path());
+        csv::FileSink file(path, buffer.stats());
+        FBExport::ParquetFile parquet(file, buffer, csvExport.fields(), csvExport.names(), m_parquetOptions);
+        if (replay) {
+            csvExport.printRows(status, parquet, *replay, &jobMetrics);
+        }
+        else {
+            csvExport.printData(status, parquet, tableDesc.range, &jobMetrics);
+        }
+        parquet.close();
+        file.close();
     }
 
     int ExportApp::exportData()
@@ -496,6 +1698,10 @@ namespace FBExport
         try
         {
             auto start = std::chrono::steady_clock::now();
+            ExportMetrics metrics;
+            metrics.setTimed(!m_report.empty());
+            metrics.setTracing(!m_trace.empty());
+            const auto attachStart = metrics.elapsed();
 
             Firebird::ThrowStatusWrapper status(fb_master->getStatus());
 
@@ -529,20 +1735,82 @@ namespace FBExport
                 )
             );
 
+            metrics.addSpan("attach", 0, attachStart);
+
+            const auto planStart = metrics.elapsed();
             auto tables = getTablesDesc(&status, att, tra, m_sqlDialect, m_filter, m_parallel == 1);
+            PageGeometry geometry;
+            SizeHints hints;
+            if (!m_sizeHints.empty()) {
+                hints = readSizeHints(m_sizeHints);
+            }
+            if (m_parallel > 1) {
+                JobPlan plan;
+                plan.size = m_jobSize;
+                plan.workers = m_parallel;
+                plan.pageSize = getPageSize(&status, att);
+                plan.pageSplit = m_pageSplit;
+                if (m_pageSplit > 1 || m_workStealing) {
+                    plan.geometry = getPageGeometry(&status, att, tra, m_sqlDialect);
+                    if (!plan.geometry.valid()) {
+                        std::cerr << "Warning: the page geometry is unknown or RDB$DB_KEY is not little-endian, data page ranges are disabled" << std::endl;
+                        plan.pageSplit = 1;
+                        m_workStealing = false;
+                    }
+                }
+                tables = planJobs(orderBySize(tables, plan, hints), plan);
+                geometry = plan.geometry;
+            }
+            metrics.addSpan("plan", 0, planStart);
+
+            csv::WriteStats writeStats;
+            BlobStats blobStats;
+
+            if (m_progressInterval.count() > 0) {
+                // the ETA needs the size of every table from the previous run
+                uint64_t expectedBytes = 0;
+                std::string lastTable;
+                for (const auto& tableDesc : tables) {
+                    if (tableDesc.relation_name == lastTable) {
+                        continue;
+                    }
+                    lastTable = tableDesc.relation_name;
+                    auto it = hints.find(tableDesc.relation_name);
+                    if (it == hints.end()) {
+                        expectedBytes = 0;
+                        break;
+                    }
+                    expectedBytes += it->second;
+                }
+                metrics.startProgress(m_progressInterval, expectedBytes);
+            }
+
+            if (m_compression != csv::Compression::NONE && m_outputFormat != OutputFormat::PARQUET) {
+                m_compressorPool = std::make_unique<csv::CompressorPool>(
+                    m_compression, m_compressLevel, m_compressBlockSize, m_compressThreads);
+            }
+
+            if (!m_captureDir.empty()) {
+                fs::create_directories(m_captureDir);
+            }
 
             if (m_parallel == 1) {
                 auto start_p = std::chrono::steady_clock::now();
                 FBExport::CSVExportTable csvExport(att, tra, fb_master);
+                csvExport.setFormatOptions(m_formatOptions);
+                csvExport.setBinaryFormat(binaryFormat());
+                csvExport.setFormatThreads(m_formatThreads);
+                csvExport.setStatementCacheSize(m_stmtCacheSize);
+                csvExport.setMetrics(metrics);
+                csv::OutputBuffer buffer(m_bufferSize);
+                buffer.setProgress(metrics.progressBytes());
                 for (const auto& tableDesc : tables) {
-                    csvExport.prepare(&status, tableDesc.relation_name, m_sqlDialect, false);
-                    const std::string fileName = tableDesc.relation_name + ".csv";
-                    csv::CSVFile csv(m_outputDir / fileName);
-                    if (m_printHeader) {
-                        csvExport.printHeader(&status, csv);
-                    }
-                    csvExport.printData(&status, csv);
+                    ExportJob job;
+                    job.desc = tableDesc;
+                    exportByTableDesc(&status, csvExport, job, buffer, nullptr, metrics, 0);
                 }
+                writeStats += buffer.stats();
+                blobStats += csvExport.blobStats();
                 auto end_p = std::chrono::steady_clock::now();
                 std::cout << "Elapsed time in milliseconds parallel_part: "
                     << std::chrono::duration_cast<std::chrono::milliseconds>(end_p - start_p).count()
@@ -557,45 +1825,116 @@ namespace FBExport
                 std::exception_ptr exceptionPointer = nullptr;
 
                 std::mutex m;
-                std::atomic<size_t> counter = 0;
+
+                // Parts are taken from the queue in the page order, the merger relies on that.
+                // In the work stealing mode any table can get more parts, so all of them are merged.
+                csv::PartMerger merger(m_mergeMemory);
+                for (const auto& tableDesc : tables) {
+                    if ((tableDesc.part_count > 1 || m_workStealing) && tableDesc.part_number == 0 && m_outputFormat != OutputFormat::PARQUET) {
+                        merger.addFile(
+                            tableDesc.relation_name, 
+                            getOutputPath(tableDesc.relation_name), 
+                            tableDesc.part_count,
+                            getFileFraming(FBExport::binaryHeader(binaryFormat())),
+                            getFileFraming(FBExport::binaryTrailer(binaryFormat())));
+                    }
+                }
+                JobQueue queue(tables, merger, geometry, m_workStealing);
+                // each worker has its own output buffer, the counters are collected after the join
+                std::vector<csv::WriteStats> workerStats(workerCount);
+                std::vector<BlobStats> workerBlobStats(workerCount);
+
+                // the first error is reported, the next ones are usually caused by it
+                auto setError = [&](std::exception_ptr error) {
+                    std::unique_lock<std::mutex> lock(m);
+                    if (!exceptionPointer) {
+                        exceptionPointer = error;
+                    }
+                    queue.stop();
+                    merger.abort();
+                };
+
+                // a worker attachment that hangs in the connect does not outlive the startup timeout
+                Firebird::AutoDispose<Firebird::IXpbBuilder> workerDpbBuilder(
+                    fbUtil->getXpbBuilder(&status, Firebird::IXpbBuilder::DPB, dpb, dbpLength));
+                workerDpbBuilder->insertInt(&status, isc_dpb_connect_timeout, static_cast<int>(m_startupTimeout.count()));
+                const auto workerDpb = workerDpbBuilder->getBuffer(&status);
+                const auto workerDpbLength = workerDpbBuilder->getBufferLength(&status);
+
+                StartupLatch startup(workerCount);
 
                 std::vector<std::thread> thread_pool;
                 thread_pool.reserve(workerCount);
-                // worker threads
+                // worker threads, each one attaches itself
                 for (int i = 0; i < workerCount; i++) {
-                    Firebird::AutoRelease<Firebird::IAttachment> workerAtt(
-                        provider->attachDatabase(
-                            &status,
-                            m_database.c_str(),
-                            dbpLength,
-                            dpb
-                        )
-                    );
-                    Firebird::AutoDispose<Firebird::IXpbBuilder> tpbWorkerBuilder(fbUtil->getXpbBuilder(&status, Firebird::IXpbBuilder::TPB, nullptr, 0));
-                    tpbWorkerBuilder->insertTag(&status, isc_tpb_concurrency);
-                    tpbWorkerBuilder->insertBigInt(&status, isc_tpb_at_snapshot_number, snapshotNumber);
-
-                    Firebird::AutoRelease<Firebird::ITransaction> workerTra(
-                        workerAtt->startTransaction(
-                            &status,
-                            tpbWorkerBuilder->getBufferLength(&status),
-                            tpbWorkerBuilder->getBuffer(&status)
-                        )
-                    );
-
-                    std::thread t([att = std::move(workerAtt), tra = std::move(workerTra), 
-                                   this, &m, &tables, &counter, &exceptionPointer]() mutable {
+                    std::thread t([this, i, &provider, workerDpb, workerDpbLength, snapshotNumber, 
+                                   &startup, &queue, &merger, &setError, &metrics,
+                                   &stats = workerStats[i], &workerBlobs = workerBlobStats[i]]() {
                         Firebird::ThrowStatusWrapper status(fb_master->getStatus());
+                        Firebird::AutoRelease<Firebird::IAttachment> att;
+                        Firebird::AutoRelease<Firebird::ITransaction> tra;
+                        const auto worker = static_cast<unsigned>(i + 1);
+                        const auto attachStart = metrics.elapsed();
+
+                        try {
+                            att.reset(provider->attachDatabase(
+                                &status,
+                                m_database.c_str(),
+                                workerDpbLength,
+                                workerDpb
+                            ));
+                            auto fbUtil = fb_master->getUtilInterface();
+                            Firebird::AutoDispose<Firebird::IXpbBuilder> tpbWorkerBuilder(fbUtil->getXpbBuilder(&status, Firebird::IXpbBuilder::TPB, nullptr, 0));
+                            tpbWorkerBuilder->insertTag(&status, isc_tpb_concurrency);
+                            tpbWorkerBuilder->insertBigInt(&status, isc_tpb_at_snapshot_number, snapshotNumber);
+
+                            tra.reset(att->startTransaction(
+                                &status,
+                                tpbWorkerBuilder->getBufferLength(&status),
+                                tpbWorkerBuilder->getBuffer(&status)
+                            ));
+                            metrics.addSpan("attach", worker, attachStart);
+                        }
+                        catch (const Firebird::FbException& e) {
+                            setError(std::make_exception_ptr(std::runtime_error(
+                                "worker " + std::to_string(i + 1) + " can not start: " + getErrorMessage(e))));
+                            startup.fail();
+                            return;
+                        }
+                        catch (...) {
+                            setError(std::current_exception());
+                            startup.fail();
+                            return;
+                        }
 
                         try {
+                            const auto waitStart = metrics.elapsed();
+                            const bool started = startup.arrive();
+                            metrics.addSpan("wait for workers", worker, waitStart);
+                            if (!started) {
+                                // the export is cancelled while the worker was starting
+                                tra->rollback(&status);
+                                tra.release();
+                                att->detach(&status);
+                                att.release();
+                                return;
+                            }
                             FBExport::CSVExportTable csvExport(att, tra, fb_master);
-                            while (true) {
-                                size_t localCounter = counter++;
-                                if (localCounter >= tables.size())
-                                    break;
-                                const auto& tableDesc = tables[localCounter];
-                                exportByTableDesc(&status, csvExport, tableDesc);
+                            csvExport.setFormatOptions(m_formatOptions);
+                            csvExport.setBinaryFormat(binaryFormat());
+                            csvExport.setFormatThreads(m_formatThreads);
+                            csvExport.setStatementCacheSize(m_stmtCacheSize);
+                            csvExport.setWorkStealing(m_workStealing);
+                            csvExport.setMetrics(metrics);
+                            csv::OutputBuffer buffer(m_bufferSize);
+                            buffer.setProgress(metrics.progressBytes());
+                            JobQueue::Job job;
+                            while (queue.take(job)) {
+                                exportByTableDesc(&status, csvExport, *job, buffer, &merger, metrics, worker);
+                                queue.release(job);
                             }
+                            stats = buffer.stats();
+                            workerBlobs = csvExport.blobStats();
                             if (tra) {
                                 tra->commit(&status);
                                 tra.release();
@@ -607,21 +1946,46 @@ namespace FBExport
                             }
                         }
                         catch (...) {
-                            std::unique_lock<std::mutex> lock(m);
-                            exceptionPointer = std::current_exception();
+                            setError(std::current_exception());
                         }
                         });
                     thread_pool.push_back(std::move(t));
                 }
 
                 // export in main threads
-                FBExport::CSVExportTable csvExport(att, tra, fb_master);
-                while (true) {
-                    size_t localCounter = counter++;
-                    if (localCounter >= tables.size())
-                        break;
-                    const auto& tableDesc = tables[localCounter];
-                    exportByTableDesc(&status, csvExport, tableDesc);
+                try {
+                    size_t pending = 0;
+                    const auto waitStart = metrics.elapsed();
+                    const bool started = startup.wait(m_startupTimeout, pending);
+                    metrics.addSpan("wait for workers", 0, waitStart);
+                    if (!started) {
+                        if (pending > 0) {
+                            throw std::runtime_error(std::to_string(pending) + " of " + std::to_string(workerCount) + 
+                                " workers have not started in " + std::to_string(m_startupTimeout.count()) + " s");
+                        }
+                        // the error of the worker is reported
+                        throw std::runtime_error("worker start failed");
+                    }
+                    FBExport::CSVExportTable csvExport(att, tra, fb_master);
+                    csvExport.setFormatOptions(m_formatOptions);
+                    csvExport.setBinaryFormat(binaryFormat());
+                    csvExport.setFormatThreads(m_formatThreads);
+                    csvExport.setStatementCacheSize(m_stmtCacheSize);
+                    csvExport.setWorkStealing(m_workStealing);
+                    csvExport.setMetrics(metrics);
+                    csv::OutputBuffer buffer(m_bufferSize);
+                    buffer.setProgress(metrics.progressBytes());
+                    JobQueue::Job job;
+                    while (queue.take(job)) {
+                        exportByTableDesc(&status, csvExport, *job, buffer, &merger, metrics, 0);
+                        queue.release(job);
+                    }
+                    writeStats += buffer.stats();
+                    blobStats += csvExport.blobStats();
+                }
+                catch (...) {
+                    // the workers must be stopped and joined before the error is reported
+                    setError(std::current_exception());
                 }
 
 
@@ -631,30 +1995,18 @@ namespace FBExport
                 if (exceptionPointer) {
                     std::rethrow_exception(exceptionPointer);
                 }
+                for (const auto& stats : workerStats) {
+                    writeStats += stats;
+                }
+                for (const auto& stats : workerBlobStats) {
+                    blobStats += stats;
+                }
+                writeStats += merger.stats();
 
                 auto end_p = std::chrono::steady_clock::now();
                 std::cout << "Elapsed time in milliseconds parallel_part: "
                     << std::chrono::duration_cast<std::chrono::milliseconds>(end_p - start_p).count()
                     << " ms" << std::endl;
-
-                // For each large table, the CSV files are merged into one (main) file.
-                for (size_t i = 0; i < tables.size(); i++) {
-                    const auto& tableDesc = tables[i];
-                    if (tableDesc.pp_cnt > 1) {
-                        std::string fileName = tableDesc.relation_name + ".csv";
-                        std::ofstream ofile(m_outputDir / fileName, std::ios::out | std::ios::app);
-                        i++;
-                        for (int64_t j = 1; j < tableDesc.pp_cnt; j++, i++) {
-                            std::string partFileName = fileName + ".part_" + std::to_string(j);
-                            auto partFilePath = m_outputDir / partFileName;
-                            std::ifstream ifile(partFilePath, std::ios::in);
-                            ofile << ifile.rdbuf();
-                            ifile.close();
-                            fs::remove(partFilePath);
-                        }
-                        ofile.close();
-                    }
-                }
             }
 
             if (tra) {
@@ -667,17 +2019,174 @@ namespace FBExport
                 att.release();
             }
 
-            auto end = std::chrono::steady_clock::now();
+            metrics.stopProgress();
+
+            if (!m_sizeHints.empty()) {
+                // The CSV size before compression is kept, it is what the ETA is measured in.
+                // The hints of the tables not exported this time are kept.
+                for (const auto& [name, bytes] : metrics.tableBytes()) {
+                    hints[name] = bytes;
+                }
+                writeSizeHints(m_sizeHints, hints);
+            }
+
+            reportRun(metrics, writeStats, blobStats, start);
+        }
+        catch (const Firebird::FbException& e) {
+            std::cerr << "Error: " << getErrorMessage(e) << std::endl;
+            return 1;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int ExportApp::replayData()
+    {
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+            ExportMetrics metrics;
+            metrics.setTimed(!m_report.empty());
+            metrics.setTracing(!m_trace.empty());
+            Firebird::ThrowStatusWrapper status(fb_master->getStatus());
+
+            const auto planStart = metrics.elapsed();
+            // the jobs of the capture run, every table gets a number of its own for orderBySize
+            std::vector<TableDesc> parts;
+            SizeHints captureSizes;
+            for (const auto& entry : fs::directory_iterator(m_replayDir)) {
+                if (!entry.is_regular_file() || entry.path().extension() != CAPTURE_EXTENSION) {
+                    continue;
+                }
+                CaptureReader reader(entry.path());
+                const auto& header = reader.header();
+                TableDesc tableDesc;
+                tableDesc.relation_name = header.tableName;
+                tableDesc.page_sequence = header.pageSequence;
+                tableDesc.pp_cnt = header.pointerPages;
+                tableDesc.part_number = static_cast<size_t>(header.partNumber);
+                tableDesc.part_count = static_cast<size_t>(header.partCount);
+                parts.push_back(tableDesc);
+                captureSizes[header.tableName] += entry.file_size();
+            }
+            if (parts.empty()) {
+                throw std::runtime_error("no capture files in " + m_replayDir.string());
+            }
+            std::sort(parts.begin(), parts.end(), [](const TableDesc& a, const TableDesc& b) {
+                return a.relation_name != b.relation_name ? a.relation_name < b.relation_name : a.part_number < b.part_number;
+            });
+            short releationId = -1;
+            size_t first = 0;
+            for (size_t i = 0; i < parts.size(); i++) {
+                if (i == 0 || parts[i].relation_name != parts[first].relation_name) {
+                    first = i;
+                    releationId++;
+                }
+                parts[i].releation_id = releationId;
+                // the merger waits for every part of the file
+                const bool last = i + 1 == parts.size() || parts[i + 1].relation_name != parts[first].relation_name;
+                if (parts[i].part_number != i - first || parts[i].part_count != parts[first].part_count ||
+                    (last && parts[i].part_count != i - first + 1))
+                {
+                    throw std::runtime_error("the capture of " + parts[i].relation_name + " is incomplete");
+                }
+            }
+            const auto tables = orderBySize(parts, JobPlan(), captureSizes);
+            metrics.addSpan("plan", 0, planStart);
+
+            if (m_progressInterval.count() > 0) {
+                metrics.startProgress(m_progressInterval, 0);
+            }
+
+            if (m_compression != csv::Compression::NONE && m_outputFormat != OutputFormat::PARQUET) {
+                m_compressorPool = std::make_unique<csv::CompressorPool>(
+                    m_compression, m_compressLevel, m_compressBlockSize, m_compressThreads);
+            }
+
+            csv::WriteStats writeStats;
+            BlobStats blobStats;
+            auto start_p = std::chrono::steady_clock::now();
+            const auto workerCount = m_parallel - 1;
+            std::exception_ptr exceptionPointer = nullptr;
+            std::mutex m;
+
+            csv::PartMerger merger(m_mergeMemory);
+            for (const auto& tableDesc : tables) {
+                if (tableDesc.part_count > 1 && tableDesc.part_number == 0 && m_outputFormat != OutputFormat::PARQUET) {
+                    merger.addFile(
+                        tableDesc.relation_name,
+                        getOutputPath(tableDesc.relation_name),
+                        tableDesc.part_count,
+                        getFileFraming(FBExport::binaryHeader(binaryFormat())),
+                        getFileFraming(FBExport::binaryTrailer(binaryFormat())));
+                }
+            }
+            JobQueue queue(tables, merger, PageGeometry(), false);
+            std::vector<csv::WriteStats> workerStats(workerCount);
+
+            auto setError = [&](std::exception_ptr error) {
+                std::unique_lock<std::mutex> lock(m);
+                if (!exceptionPointer) {
+                    exceptionPointer = error;
+                }
+                queue.stop();
+                merger.abort();
+            };
+
+            // the replay has no connection, every thread only formats and writes
+            auto replayJobs = [&](unsigned worker, csv::WriteStats& stats) {
+                try {
+                    Firebird::ThrowStatusWrapper status(fb_master->getStatus());
+                    FBExport::CSVExportTable csvExport(nullptr, nullptr, fb_master);
+                    csvExport.setFormatOptions(m_formatOptions);
+                    csvExport.setBinaryFormat(binaryFormat());
+                    csvExport.setFormatThreads(m_formatThreads);
+                    csvExport.setMetrics(metrics);
+                    csv::OutputBuffer buffer(m_bufferSize);
+                    buffer.setProgress(metrics.progressBytes());
+                    JobQueue::Job job;
+                    while (queue.take(job)) {
+                        exportByTableDesc(&status, csvExport, *job, buffer, &merger, metrics, worker);
+                        queue.release(job);
+                    }
+                    stats = buffer.stats();
+                }
+                catch (...) {
+                    setError(std::current_exception());
+                }
+            };
 
-            std::cout << "Elapsed time in milliseconds: "
-                << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            std::vector<std::thread> thread_pool;
+            thread_pool.reserve(workerCount);
+            for (int i = 0; i < workerCount; i++) {
+                thread_pool.emplace_back(replayJobs, static_cast<unsigned>(i + 1), std::ref(workerStats[i]));
+            }
+            replayJobs(0, writeStats);
+            for (auto& th : thread_pool) {
+                th.join();
+            }
+            if (exceptionPointer) {
+                std::rethrow_exception(exceptionPointer);
+            }
+            for (const auto& stats : workerStats) {
+                writeStats += stats;
+            }
+            writeStats += merger.stats();
+
+            auto end_p = std::chrono::steady_clock::now();
+            std::cout << "Elapsed time in milliseconds parallel_part: "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(end_p - start_p).count()
                 << " ms" << std::endl;
 
+            metrics.stopProgress();
+            reportRun(metrics, writeStats, blobStats, start);
         }
         catch (const Firebird::FbException& e) {
-            char buffer[2048];
-            fbUtil->formatStatus(buffer, static_cast<unsigned int>(std::size(buffer)), e.getStatus());
-            std::cerr << "Error: " << buffer << std::endl;
+            std::cerr << "Error: " << getErrorMessage(e) << std::endl;
             return 1;
         }
         catch (const std::exception& e) {
@@ -687,6 +2196,38 @@ namespace FBExport
 
         return 0;
     }
+
+    void ExportApp::reportRun(
+        ExportMetrics& metrics,
+        const csv::WriteStats& writeStats,
+        const BlobStats& blobStats,
+        std::chrono::steady_clock::time_point start)
+    {
+        if (!m_report.empty() && !metrics.writeReport(m_report, static_cast<unsigned>(m_parallel), writeStats, blobStats)) {
+            std::cerr << "Warning: can not write the report to " << m_report.string() << std::endl;
+        }
+
+        if (!m_trace.empty() && !metrics.writeTrace(m_trace, static_cast<unsigned>(m_parallel))) {
+            std::cerr << "Warning: can not write the trace to " << m_trace.string() << std::endl;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+
+        std::cout << "Bytes written: " << writeStats.bytes
+            << ", write calls: " << writeStats.syscalls << std::endl;
+
+        if (blobStats.count > 0) {
+            std::cout << "BLOBs: " << blobStats.count
+                << ", streamed: " << blobStats.streamed
+                << ", bytes read: " << blobStats.bytes
+                << ", open time: " << std::chrono::duration_cast<std::chrono::milliseconds>(blobStats.openTime).count()
+                << " ms" << std::endl;
+        }
+
+        std::cout << "Elapsed time in milliseconds: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+            << " ms" << std::endl;
+    }
 } // namespace FBExport
 
 using namespace FBExport;
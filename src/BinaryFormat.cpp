@@ -0,0 +1,651 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "BinaryFormat.h"
+#include "DecimalFormat.h"
+#include "HexFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    using FBExport::FormatContext;
+    using FBExport::BinaryColumn;
+    using csv::OutputBuffer;
+
+    constexpr char PGCOPY_HEADER[] = "PGCOPY\n\xFF\r\n\0"
+        // flags and the length of the header extension
+        "\0\0\0\0" "\0\0\0\0";
+    constexpr char PGCOPY_TRAILER[] = "\xFF\xFF";
+
+    // Firebird dates are counted from 1858-11-17
+    constexpr int64_t UNIX_EPOCH_DATE = 40587;
+    // PostgreSQL dates and timestamps are counted from 2000-01-01
+    constexpr int64_t POSTGRES_EPOCH_DATE = 51544;
+    constexpr int64_t MICROS_PER_DAY = 86400LL * 1000000;
+    // ISC_TIME is in 1/10000 of a second
+    constexpr int64_t MICROS_PER_TIME_UNIT = 100;
+    constexpr int64_t MICROS_PER_MINUTE = 60LL * 1000000;
+
+    // Sign of the PostgreSQL NUMERIC
+    constexpr uint16_t NUMERIC_POS = 0x0000;
+    constexpr uint16_t NUMERIC_NEG = 0x4000;
+    constexpr uint16_t NUMERIC_NAN = 0xC000;
+    constexpr uint16_t NUMERIC_PINF = 0xD000;
+    constexpr uint16_t NUMERIC_NINF = 0xF000;
+    // base 10000 digits of the longest value: 38 decimal digits and the alignment of both ends
+    constexpr size_t MAX_NUMERIC_DIGITS = 12;
+    constexpr size_t MAX_NUMERIC_TEXT = 64;
+
+    constexpr char WHITESPACE[] = " \n\r\t\f\v";
+
+    size_t rtrimLength(const char* s, size_t length)
+    {
+        while (length > 0 && s[length - 1] != '\0' && std::strchr(WHITESPACE, s[length - 1])) {
+            length--;
+        }
+        return length;
+    }
+
+    template <typename T>
+    T readValue(const unsigned char* value)
+    {
+        T result;
+        std::memcpy(&result, value, sizeof(T));
+        return result;
+    }
+
+    // PostgreSQL numbers are big-endian
+    template <typename T>
+    char* putBigEndian(char* p, T value)
+    {
+        using U = std::make_unsigned_t<T>;
+        const auto bits = static_cast<U>(value);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            *p++ = static_cast<char>(bits >> (8 * (sizeof(T) - 1 - i)));
+        }
+        return p;
+    }
+
+    // ClickHouse numbers are little-endian, as the message on the platforms Firebird runs on
+    template <typename T>
+    void putLittleEndian(OutputBuffer& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    int64_t toMicros(ISC_DATE date, ISC_TIME time, int64_t epoch)
+    {
+        return (static_cast<int64_t>(date) - epoch) * MICROS_PER_DAY + static_cast<int64_t>(time) * MICROS_PER_TIME_UNIT;
+    }
+
+    int floorDiv4(int value)
+    {
+        return value >= 0 ? value / 4 : -((-value + 3) / 4);
+    }
+
+    // ---------------------------------------------------------------------------
+    // PostgreSQL COPY BINARY, every field is prefixed by its 32-bit length
+
+    template <typename T>
+    void writePgValue(OutputBuffer& out, T value)
+    {
+        char* p = out.reserve(sizeof(int32_t) + sizeof(T));
+        p = putBigEndian(p, static_cast<int32_t>(sizeof(T)));
+        out.commitTo(putBigEndian(p, value));
+    }
+
+    void writePgBytes(OutputBuffer& out, const char* data, size_t size)
+    {
+        char* p = out.reserve(sizeof(int32_t));
+        out.commitTo(putBigEndian(p, static_cast<int32_t>(size)));
+        out.append(data, size);
+    }
+
+    void writePgSpecial(OutputBuffer& out, uint16_t sign)
+    {
+        char* p = out.reserve(sizeof(int32_t) + 8);
+        p = putBigEndian(p, int32_t{ 8 });
+        p = putBigEndian(p, int16_t{ 0 });
+        p = putBigEndian(p, int16_t{ 0 });
+        p = putBigEndian(p, sign);
+        out.commitTo(putBigEndian(p, int16_t{ 0 }));
+    }
+
+    // NUMERIC of the decimal digits multiplied by 10^exponent. PostgreSQL keeps the digits
+    // in base 10000 groups aligned at the decimal point, the weight is the power of the first group.
+    void writePgNumeric(OutputBuffer& out, bool negative, const char* digits, size_t count, int exponent)
+    {
+        while (count > 0 && *digits == '0') {
+            digits++;
+            count--;
+        }
+        const int dscale = exponent < 0 ? -exponent : 0;
+        int16_t groups[MAX_NUMERIC_DIGITS] = {};
+        int ndigits = 0;
+        int weight = 0;
+        if (count > 0) {
+            const int first = floorDiv4(exponent + static_cast<int>(count) - 1);
+            const int last = floorDiv4(exponent);
+            ndigits = first - last + 1;
+            for (size_t i = 0; i < count; i++) {
+                const int power = exponent + static_cast<int>(count - 1 - i);
+                const int group = floorDiv4(power);
+                int factor = 1;
+                for (int k = power - 4 * group; k > 0; k--) {
+                    factor *= 10;
+                }
+                groups[first - group] = static_cast<int16_t>(groups[first - group] + (digits[i] - '0') * factor);
+            }
+            weight = first;
+            // the first digit is not zero, but the trailing groups may be
+            while (ndigits > 0 && groups[ndigits - 1] == 0) {
+                ndigits--;
+            }
+        }
+        const size_t size = 8 + 2 * static_cast<size_t>(ndigits);
+        char* p = out.reserve(sizeof(int32_t) + size);
+        p = putBigEndian(p, static_cast<int32_t>(size));
+        p = putBigEndian(p, static_cast<int16_t>(ndigits));
+        p = putBigEndian(p, static_cast<int16_t>(weight));
+        p = putBigEndian(p, ndigits > 0 && negative ? NUMERIC_NEG : NUMERIC_POS);
+        p = putBigEndian(p, static_cast<int16_t>(dscale));
+        for (int i = 0; i < ndigits; i++) {
+            p = putBigEndian(p, groups[i]);
+        }
+        out.commitTo(p);
+    }
+
+    // NUMERIC from the text of formatScaledInt128 or formatDecFloatXX:
+    // [-]digits[.digits][E[+-]exponent], Infinity or NaN
+    void writePgNumericText(OutputBuffer& out, const char* s, const char* end, int exponent)
+    {
+        const bool negative = s < end && *s == '-';
+        if (negative) {
+            s++;
+        }
+        if (s < end && (*s < '0' || *s > '9')) {
+            writePgSpecial(out, *s == 'I' ? (negative ? NUMERIC_NINF : NUMERIC_PINF) : NUMERIC_NAN);
+            return;
+        }
+        char digits[MAX_NUMERIC_TEXT];
+        size_t count = 0;
+        bool fraction = false;
+        for (; s < end && *s != 'E'; s++) {
+            if (*s == '.') {
+                fraction = true;
+                continue;
+            }
+            digits[count++] = *s;
+            // every digit after the point lowers the exponent
+            if (fraction) {
+                exponent--;
+            }
+        }
+        if (s < end) {
+            // E+NN or E-NN
+            const bool negativeExponent = ++s < end && *s == '-';
+            int value = 0;
+            for (s++; s < end; s++) {
+                value = value * 10 + (*s - '0');
+            }
+            exponent += negativeExponent ? -value : value;
+        }
+        writePgNumeric(out, negative, digits, count, exponent);
+    }
+
+    void pgBoolean(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        writePgValue(out, static_cast<uint8_t>(*value ? 1 : 0));
+    }
+
+    template <typename T>
+    void pgInteger(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        writePgValue(out, readValue<T>(value));
+    }
+
+    template <typename T>
+    void pgScaledInteger(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        const int64_t number = readValue<T>(value);
+        // the magnitude of INT64_MIN does not fit into int64_t
+        uint64_t magnitude = number < 0 ? 0 - static_cast<uint64_t>(number) : static_cast<uint64_t>(number);
+        char digits[20];
+        char* p = digits + sizeof(digits);
+        do {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        writePgNumeric(out, number < 0, p, static_cast<size_t>(digits + sizeof(digits) - p), column.scale);
+    }
+
+    void pgInt128(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        char text[FBExport::MAX_SCALED_INT128_LENGTH];
+        const char* end = FBExport::formatScaledInt128(text, readValue<FB_I128_t>(value), 0);
+        writePgNumericText(out, text, end, column.scale);
+    }
+
+    template <typename T>
+    void pgDecFloat(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        char text[FBExport::MAX_DECFLOAT34_LENGTH];
+        const char* end;
+        if constexpr (sizeof(T) == sizeof(FB_DEC16_t)) {
+            end = FBExport::formatDecFloat16(text, readValue<FB_DEC16_t>(value));
+        }
+        else {
+            end = FBExport::formatDecFloat34(text, readValue<FB_DEC34_t>(value));
+        }
+        writePgNumericText(out, text, end, 0);
+    }
+
+    template <typename T, typename U>
+    void pgFloat(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const T number = readValue<T>(value);
+        U bits;
+        std::memcpy(&bits, &number, sizeof(bits));
+        writePgValue(out, bits);
+    }
+
+    void pgDate(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        writePgValue(out, static_cast<int32_t>(readValue<ISC_DATE>(value) - POSTGRES_EPOCH_DATE));
+    }
+
+    // TIME WITH TIME ZONE values start with the UTC time
+    void pgTime(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        writePgValue(out, static_cast<int64_t>(readValue<ISC_TIME>(value)) * MICROS_PER_TIME_UNIT);
+    }
+
+    void pgTimestamp(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP>(value);
+        writePgValue(out, toMicros(ts.timestamp_date, ts.timestamp_time, POSTGRES_EPOCH_DATE));
+    }
+
+    // timestamptz is UTC, ISC_TIMESTAMP_TZ_EX starts with ISC_TIMESTAMP_TZ
+    void pgTimestampTz(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP_TZ>(value).utc_timestamp;
+        writePgValue(out, toMicros(ts.timestamp_date, ts.timestamp_time, POSTGRES_EPOCH_DATE));
+    }
+
+    // timetz is the local time and the zone offset in seconds west of UTC
+    void writePgTimeTz(OutputBuffer& out, ISC_TIME utcTime, int offsetMinutes)
+    {
+        int64_t micros = static_cast<int64_t>(utcTime) * MICROS_PER_TIME_UNIT + offsetMinutes * MICROS_PER_MINUTE;
+        micros = (micros % MICROS_PER_DAY + MICROS_PER_DAY) % MICROS_PER_DAY;
+        char* p = out.reserve(sizeof(int32_t) + 12);
+        p = putBigEndian(p, int32_t{ 12 });
+        p = putBigEndian(p, micros);
+        out.commitTo(putBigEndian(p, static_cast<int32_t>(-offsetMinutes * 60)));
+    }
+
+    // The region time zones need the time zone database, their values are written in UTC
+    void pgTimeTz(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto tz = readValue<ISC_TIME_TZ>(value);
+        writePgTimeTz(out, tz.utc_time, FBExport::isOffsetTimeZone(tz.time_zone) ? FBExport::offsetTimeZoneMinutes(tz.time_zone) : 0);
+    }
+
+    void pgTimeTzEx(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto tz = readValue<ISC_TIME_TZ_EX>(value);
+        writePgTimeTz(out, tz.utc_time, tz.ext_offset);
+    }
+
+    void pgChar(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        auto s = reinterpret_cast<const char*>(value);
+        writePgBytes(out, s, rtrimLength(s, column.length));
+    }
+
+    void pgBinary(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        writePgBytes(out, reinterpret_cast<const char*>(value), column.length);
+    }
+
+    // The bytes of uuid are in the order of its text, Data1..Data3 of Guid are in the host order
+    void uuidBytes(const unsigned char* value, unsigned char* bytes)
+    {
+        const auto guid = readValue<Firebird::Guid>(value);
+        for (unsigned i = 0; i < 4; i++) {
+            bytes[i] = static_cast<unsigned char>(guid.Data1 >> (24 - 8 * i));
+        }
+        bytes[4] = static_cast<unsigned char>(guid.Data2 >> 8);
+        bytes[5] = static_cast<unsigned char>(guid.Data2);
+        bytes[6] = static_cast<unsigned char>(guid.Data3 >> 8);
+        bytes[7] = static_cast<unsigned char>(guid.Data3);
+        std::memcpy(bytes + 8, guid.Data4, sizeof(guid.Data4));
+    }
+
+    void pgGuid(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        unsigned char bytes[16];
+        uuidBytes(value, bytes);
+        writePgBytes(out, reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    void pgVarChar(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        auto len = readValue<unsigned short>(value);
+        writePgBytes(out, reinterpret_cast<const char*>(value + 2), len);
+    }
+
+    void pgBlob(FormatContext& ctx, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        ctx.blobs->read(ctx.status, ctx.att, ctx.tra, readValue<ISC_QUAD>(value), ctx.blob);
+        writePgBytes(out, ctx.blob.data(), ctx.blob.size());
+    }
+
+    // ARRAY and unknown types, NULL values are written by the row loop
+    void pgNull(FormatContext&, const BinaryColumn&, const unsigned char*, OutputBuffer& out)
+    {
+        out.append("\xFF\xFF\xFF\xFF", 4);
+    }
+
+    template <typename T>
+    FBExport::BinaryFunc choosePgInteger(int scale)
+    {
+        return scale == 0 ? pgInteger<T> : pgScaledInteger<T>;
+    }
+
+    // Type of the target column: boolean, smallint, integer, bigint, numeric, real,
+    // double precision, date, time, timestamp, timestamptz, timetz, uuid, text or bytea
+    FBExport::BinaryFunc choosePgFormat(const Firebird::SQLDA& field)
+    {
+        switch (field.type) {
+        case SQL_BOOLEAN:
+            return pgBoolean;
+        case SQL_TEXT:
+            if (field.charset == 1) {
+                return field.length == 16 ? pgGuid : pgBinary;
+            }
+            return pgChar;
+        case SQL_VARYING:
+            return pgVarChar;
+        case SQL_SHORT:
+            return choosePgInteger<short>(field.scale);
+        case SQL_LONG:
+            return choosePgInteger<int32_t>(field.scale);
+        case SQL_INT64:
+            return choosePgInteger<int64_t>(field.scale);
+        case SQL_INT128:
+            return pgInt128;
+        case SQL_FLOAT:
+            return pgFloat<float, uint32_t>;
+        case SQL_D_FLOAT:
+        case SQL_DOUBLE:
+            return pgFloat<double, uint64_t>;
+        case SQL_TYPE_DATE:
+            return pgDate;
+        case SQL_TYPE_TIME:
+            return pgTime;
+        case SQL_TIMESTAMP:
+            return pgTimestamp;
+        case SQL_DEC16:
+            return pgDecFloat<FB_DEC16_t>;
+        case SQL_DEC34:
+            return pgDecFloat<FB_DEC34_t>;
+        case SQL_TIMESTAMP_TZ:
+        case SQL_TIMESTAMP_TZ_EX:
+            return pgTimestampTz;
+        case SQL_TIME_TZ:
+            return pgTimeTz;
+        case SQL_TIME_TZ_EX:
+            return pgTimeTzEx;
+        case SQL_BLOB:
+            return pgBlob;
+        case SQL_ARRAY:
+        default:
+            return pgNull;
+        }
+    }
+
+    // ---------------------------------------------------------------------------
+    // ClickHouse RowBinary, the values have no lengths except the strings
+
+    void writeString(OutputBuffer& out, const char* data, size_t size)
+    {
+        // LEB128 length
+        char* p = out.reserve(10);
+        uint64_t length = size;
+        while (length >= 0x80) {
+            *p++ = static_cast<char>((length & 0x7F) | 0x80);
+            length >>= 7;
+        }
+        *p++ = static_cast<char>(length);
+        out.commitTo(p);
+        out.append(data, size);
+    }
+
+    void chBoolean(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        out.put(*value ? 1 : 0);
+    }
+
+    // Int16, Int32, Int64 and Int128, Decimal32, Decimal64 and Decimal128 are the same
+    // integers with the scale of the column, so the value is copied as is
+    template <typename From, typename To>
+    void chNumber(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        putLittleEndian(out, static_cast<To>(readValue<From>(value)));
+    }
+
+    void chInt128(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        out.append(reinterpret_cast<const char*>(value), sizeof(FB_I128_t));
+    }
+
+    // Date32
+    void chDate(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        putLittleEndian(out, static_cast<int32_t>(readValue<ISC_DATE>(value) - UNIX_EPOCH_DATE));
+    }
+
+    // Time64(6), TIME WITH TIME ZONE values start with the UTC time
+    void chTime(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        putLittleEndian(out, static_cast<int64_t>(readValue<ISC_TIME>(value)) * MICROS_PER_TIME_UNIT);
+    }
+
+    // DateTime64(6)
+    void chTimestamp(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP>(value);
+        putLittleEndian(out, toMicros(ts.timestamp_date, ts.timestamp_time, UNIX_EPOCH_DATE));
+    }
+
+    // DateTime64(6, 'UTC'), ISC_TIMESTAMP_TZ_EX starts with ISC_TIMESTAMP_TZ
+    void chTimestampTz(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP_TZ>(value).utc_timestamp;
+        putLittleEndian(out, toMicros(ts.timestamp_date, ts.timestamp_time, UNIX_EPOCH_DATE));
+    }
+
+    void chChar(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        auto s = reinterpret_cast<const char*>(value);
+        writeString(out, s, rtrimLength(s, column.length));
+    }
+
+    // FixedString(N)
+    void chBinary(FormatContext&, const BinaryColumn& column, const unsigned char* value, OutputBuffer& out)
+    {
+        out.append(reinterpret_cast<const char*>(value), column.length);
+    }
+
+    // UUID is two 64-bit halves of its text, each in the little-endian order
+    void chGuid(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        unsigned char bytes[16];
+        uuidBytes(value, bytes);
+        std::reverse(bytes, bytes + 8);
+        std::reverse(bytes + 8, bytes + 16);
+        out.append(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    void chVarChar(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        auto len = readValue<unsigned short>(value);
+        writeString(out, reinterpret_cast<const char*>(value + 2), len);
+    }
+
+    // DECFLOAT has no ClickHouse type of the same range, it is written as String
+    void chDec16(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        char text[FBExport::MAX_DECFLOAT16_LENGTH];
+        const char* end = FBExport::formatDecFloat16(text, readValue<FB_DEC16_t>(value));
+        writeString(out, text, static_cast<size_t>(end - text));
+    }
+
+    void chDec34(FormatContext&, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        char text[FBExport::MAX_DECFLOAT34_LENGTH];
+        const char* end = FBExport::formatDecFloat34(text, readValue<FB_DEC34_t>(value));
+        writeString(out, text, static_cast<size_t>(end - text));
+    }
+
+    void chBlob(FormatContext& ctx, const BinaryColumn&, const unsigned char* value, OutputBuffer& out)
+    {
+        ctx.blobs->read(ctx.status, ctx.att, ctx.tra, readValue<ISC_QUAD>(value), ctx.blob);
+        writeString(out, ctx.blob.data(), ctx.blob.size());
+    }
+
+    // The column is Nullable and the row loop writes the NULL flag for every row
+    void chNull(FormatContext&, const BinaryColumn&, const unsigned char*, OutputBuffer&)
+    {
+    }
+
+    // Type of the target column: Bool, Int16, Int32, Int64, Decimal(P, S), Float32, Float64,
+    // Date32, Time64(6), DateTime64(6), UUID, FixedString(N) or String, Nullable when
+    // the Firebird column is nullable
+    FBExport::BinaryFunc chooseChFormat(const Firebird::SQLDA& field)
+    {
+        switch (field.type) {
+        case SQL_BOOLEAN:
+            return chBoolean;
+        case SQL_TEXT:
+            if (field.charset == 1) {
+                return field.length == 16 ? chGuid : chBinary;
+            }
+            return chChar;
+        case SQL_VARYING:
+            return chVarChar;
+        case SQL_SHORT:
+            // Decimal(P, S) with P up to 9 is 32-bit
+            return field.scale == 0 ? chNumber<short, int16_t> : chNumber<short, int32_t>;
+        case SQL_LONG:
+            return chNumber<int32_t, int32_t>;
+        case SQL_INT64:
+            return chNumber<int64_t, int64_t>;
+        case SQL_INT128:
+            return chInt128;
+        case SQL_FLOAT:
+            return chNumber<float, float>;
+        case SQL_D_FLOAT:
+        case SQL_DOUBLE:
+            return chNumber<double, double>;
+        case SQL_TYPE_DATE:
+            return chDate;
+        case SQL_TYPE_TIME:
+        case SQL_TIME_TZ:
+        case SQL_TIME_TZ_EX:
+            return chTime;
+        case SQL_TIMESTAMP:
+            return chTimestamp;
+        case SQL_DEC16:
+            return chDec16;
+        case SQL_DEC34:
+            return chDec34;
+        case SQL_TIMESTAMP_TZ:
+        case SQL_TIMESTAMP_TZ_EX:
+            return chTimestampTz;
+        case SQL_BLOB:
+            return chBlob;
+        case SQL_ARRAY:
+        default:
+            return chNull;
+        }
+    }
+} // namespace
+
+namespace FBExport
+{
+    const char* binaryExtension(BinaryFormat format)
+    {
+        switch (format) {
+        case BinaryFormat::PGCOPY:
+            return ".pgcopy";
+        case BinaryFormat::ROWBINARY:
+            return ".rowbinary";
+        default:
+            return ".csv";
+        }
+    }
+
+    std::string_view binaryHeader(BinaryFormat format)
+    {
+        if (format == BinaryFormat::PGCOPY) {
+            return std::string_view(PGCOPY_HEADER, sizeof(PGCOPY_HEADER) - 1);
+        }
+        // not a default view, its data pointer is passed to memcpy
+        return std::string_view("", 0);
+    }
+
+    std::string_view binaryTrailer(BinaryFormat format)
+    {
+        if (format == BinaryFormat::PGCOPY) {
+            return std::string_view(PGCOPY_TRAILER, sizeof(PGCOPY_TRAILER) - 1);
+        }
+        return std::string_view("", 0);
+    }
+
+    void BinaryPlan::compile(const Firebird::SQLDAList& fields, BinaryFormat format)
+    {
+        m_format = format;
+        m_columns.clear();
+        m_columns.reserve(fields.size());
+        for (const auto& field : fields) {
+            auto&& column = m_columns.emplace_back();
+            if (format == BinaryFormat::PGCOPY) {
+                column.write = choosePgFormat(field);
+            }
+            else {
+                column.write = chooseChFormat(field);
+            }
+            column.offset = field.offset;
+            column.nullOffset = field.nullOffset;
+            column.length = field.length;
+            column.scale = static_cast<short>(field.scale);
+            // the columns of the types without a value are always NULL
+            column.alwaysNull = column.write == chNull;
+            column.nullable = field.nullable || column.alwaysNull;
+        }
+    }
+
+} // namespace FBExport
@@ -0,0 +1,126 @@
+#pragma once
+
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include "FormatPlan.h"
+#include "sqlda.h"
+#include <string_view>
+#include <vector>
+
+namespace FBExport
+{
+    // Binary row formats read by the bulk loaders without parsing text.
+    // PGCOPY is the binary format of PostgreSQL COPY ... FROM ... WITH (FORMAT binary),
+    // ROWBINARY is the RowBinary input format of ClickHouse.
+    enum class BinaryFormat { NONE, PGCOPY, ROWBINARY };
+
+    // File extension of the format, without the compression extension
+    const char* binaryExtension(BinaryFormat format);
+
+    // Bytes before the first row and after the last row of a file
+    std::string_view binaryHeader(BinaryFormat format);
+
+    std::string_view binaryTrailer(BinaryFormat format);
+
+    struct BinaryColumn;
+
+    using BinaryFunc = void (*)(FormatContext& ctx, const BinaryColumn& column, const unsigned char* value, csv::OutputBuffer& out);
+
+    // Encoder of one column chosen once from the SQLDA type, scale and character set,
+    // the value is taken from its offset in the message as is.
+    struct BinaryColumn
+    {
+        BinaryFunc write = nullptr;
+        unsigned offset = 0;
+        unsigned nullOffset = 0;
+        unsigned length = 0;
+        short scale = 0;
+        bool nullable = true;
+        // the type has no value in the target, NULL whatever the indicator says
+        bool alwaysNull = false;
+    };
+
+    // Counterpart of FormatPlan for the binary formats
+    class BinaryPlan
+    {
+        std::vector<BinaryColumn> m_columns;
+        BinaryFormat m_format = BinaryFormat::NONE;
+    public:
+        void compile(const Firebird::SQLDAList& fields, BinaryFormat format);
+
+        void clear()
+        {
+            m_columns.clear();
+            m_format = BinaryFormat::NONE;
+        }
+
+        void writeRow(FormatContext& ctx, const unsigned char* buffer, csv::OutputBuffer& out) const
+        {
+            if (m_format == BinaryFormat::PGCOPY) {
+                writePgRow(ctx, buffer, out);
+            }
+            else {
+                writeRowBinary(ctx, buffer, out);
+            }
+        }
+    private:
+        // 16-bit number of fields, then the length of each field and its value, -1 is NULL
+        void writePgRow(FormatContext& ctx, const unsigned char* buffer, csv::OutputBuffer& out) const
+        {
+            char* p = out.reserve(sizeof(uint16_t));
+            p[0] = static_cast<char>(m_columns.size() >> 8);
+            p[1] = static_cast<char>(m_columns.size());
+            out.commit(sizeof(uint16_t));
+            for (const auto& column : m_columns) {
+                if (*reinterpret_cast<const short*>(buffer + column.nullOffset)) {
+                    out.append("\xFF\xFF\xFF\xFF", 4);
+                    continue;
+                }
+                column.write(ctx, column, buffer + column.offset, out);
+            }
+        }
+
+        // The values one after another, a Nullable column starts with the NULL flag byte
+        void writeRowBinary(FormatContext& ctx, const unsigned char* buffer, csv::OutputBuffer& out) const
+        {
+            for (const auto& column : m_columns) {
+                if (column.nullable) {
+                    const bool isNull = column.alwaysNull ||
+                        *reinterpret_cast<const short*>(buffer + column.nullOffset) != 0;
+                    out.put(isNull ? 1 : 0);
+                    if (isNull) {
+                        continue;
+                    }
+                }
+                column.write(ctx, column, buffer + column.offset, out);
+            }
+        }
+    };
+
+} // namespace FBExport
+
+#endif // BINARY_FORMAT_H
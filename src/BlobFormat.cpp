@@ -0,0 +1,179 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "BlobFormat.h"
+#include "HexFormat.h"
+#include "FBAutoPtr.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    using FBExport::BlobEncoding;
+
+    size_t encodedLength(size_t size, BlobEncoding encoding)
+    {
+        return encoding == BlobEncoding::HEX ? size * 2 : FBExport::base64Length(size);
+    }
+
+    char* encode(char* out, const unsigned char* data, size_t size, BlobEncoding encoding)
+    {
+        return encoding == BlobEncoding::HEX ? FBExport::encodeHex(out, data, size) : FBExport::encodeBase64(out, data, size);
+    }
+} // namespace
+
+namespace FBExport
+{
+
+    BlobEncoding parseBlobEncoding(const std::string& name)
+    {
+        if (name == "hex") {
+            return BlobEncoding::HEX;
+        }
+        if (name == "base64") {
+            return BlobEncoding::BASE64;
+        }
+        throw std::invalid_argument("unknown BLOB format \"" + name + "\"");
+    }
+
+    BlobWriter::BlobWriter()
+        : m_buffer(BLOB_INLINE_SIZE)
+        , m_stats()
+    {
+    }
+
+    void BlobWriter::write(
+        Firebird::ThrowStatusWrapper* status,
+        Firebird::IAttachment* att,
+        Firebird::ITransaction* tra,
+        ISC_QUAD id,
+        bool text,
+        BlobEncoding encoding,
+        csv::CSVFile& csv)
+    {
+        // Firebird has no BPB item for the read size, the size of a part
+        // is the buffer length passed to getSegment
+        auto openStart = std::chrono::steady_clock::now();
+        Firebird::AutoRelease<Firebird::IBlob> blob(att->openBlob(status, tra, &id, 0, nullptr));
+        m_stats.openTime += std::chrono::steady_clock::now() - openStart;
+        m_stats.count++;
+
+        bool eof = false;
+        size_t size = fill(status, blob, 0, eof);
+        m_stats.bytes += size;
+        auto data = m_buffer.data();
+        if (eof) {
+            // the whole value is in the buffer, the most frequent case
+            if (text) {
+                csv.writeString(reinterpret_cast<const char*>(data), size);
+            }
+            else {
+                char* out = csv.reserveField(encodedLength(size, encoding));
+                csv.commitField(encode(out, data, size, encoding));
+            }
+        }
+        else {
+            m_stats.streamed++;
+            if (text) {
+                // the value is always quoted, it can not be checked for special characters in advance
+                csv.beginQuoted();
+                while (true) {
+                    csv.writeQuoted(reinterpret_cast<const char*>(data), size);
+                    if (eof) {
+                        break;
+                    }
+                    size = fill(status, blob, 0, eof);
+                    m_stats.bytes += size;
+                }
+                csv.endQuoted();
+            }
+            else {
+                bool first = true;
+                while (true) {
+                    // base64 encodes groups of 3 bytes, the rest is moved to the next part
+                    const size_t whole = eof || encoding == BlobEncoding::HEX ? size : size / 3 * 3;
+                    const size_t length = encodedLength(whole, encoding);
+                    char* out = first ? csv.reserveField(length) : csv.extendField(length);
+                    csv.commitField(encode(out, data, whole, encoding));
+                    first = false;
+                    if (eof) {
+                        break;
+                    }
+                    const size_t rest = size - whole;
+                    std::memmove(data, data + whole, rest);
+                    const size_t filled = fill(status, blob, rest, eof);
+                    m_stats.bytes += filled - rest;
+                    size = filled;
+                }
+            }
+        }
+
+        blob->close(status);
+        blob.release();
+    }
+
+    void BlobWriter::read(
+        Firebird::ThrowStatusWrapper* status,
+        Firebird::IAttachment* att,
+        Firebird::ITransaction* tra,
+        ISC_QUAD id,
+        std::string& value)
+    {
+        auto openStart = std::chrono::steady_clock::now();
+        Firebird::AutoRelease<Firebird::IBlob> blob(att->openBlob(status, tra, &id, 0, nullptr));
+        m_stats.openTime += std::chrono::steady_clock::now() - openStart;
+        m_stats.count++;
+
+        value.clear();
+        bool eof = false;
+        while (!eof) {
+            const size_t size = fill(status, blob, 0, eof);
+            value.append(reinterpret_cast<const char*>(m_buffer.data()), size);
+        }
+        m_stats.bytes += value.size();
+        if (value.size() > BLOB_INLINE_SIZE) {
+            m_stats.streamed++;
+        }
+
+        blob->close(status);
+        blob.release();
+    }
+
+    size_t BlobWriter::fill(Firebird::ThrowStatusWrapper* status, Firebird::IBlob* blob, size_t from, bool& eof)
+    {
+        size_t size = from;
+        eof = false;
+        while (size < m_buffer.size()) {
+            const auto length = static_cast<unsigned>(std::min<size_t>(m_buffer.size() - size, BLOB_SEGMENT_SIZE));
+            unsigned actual = 0;
+            const int result = blob->getSegment(status, length, m_buffer.data() + size, &actual);
+            size += actual;
+            if (result == Firebird::IStatus::RESULT_NO_DATA) {
+                eof = true;
+                break;
+            }
+        }
+        return size;
+    }
+
+} // namespace FBExport
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef BLOB_FORMAT_H
+#define BLOB_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <firebird/Interface.h>
+#include "CSVFile.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FBExport
+{
+    // Text representation of binary BLOB values
+    enum class BlobEncoding { HEX, BASE64 };
+
+    // Throws std::invalid_argument for an unknown name
+    BlobEncoding parseBlobEncoding(const std::string& name);
+
+    // The largest part of a BLOB returned by one getSegment call
+    inline constexpr unsigned BLOB_SEGMENT_SIZE = 65535;
+    // Values up to this size are read at once and written like VARCHAR and VARBINARY
+    inline constexpr size_t BLOB_INLINE_SIZE = 64 * 1024;
+
+    // BLOB counters of one export thread
+    struct BlobStats
+    {
+        uint64_t count = 0;
+        // values longer than BLOB_INLINE_SIZE, written in parts
+        uint64_t streamed = 0;
+        uint64_t bytes = 0;
+        std::chrono::nanoseconds openTime{ 0 };
+
+        BlobStats& operator += (const BlobStats& other)
+        {
+            count += other.count;
+            streamed += other.streamed;
+            bytes += other.bytes;
+            openTime += other.openTime;
+            return *this;
+        }
+    };
+
+    // Writes BLOB values of the export thread to CSV. A value is never loaded into memory
+    // as a whole: it is read in parts into the buffer, which is reused for all values.
+    // Text is escaped, binary data is encoded in hex or base64.
+    class BlobWriter
+    {
+        std::vector<unsigned char> m_buffer;
+        BlobStats m_stats;
+    public:
+        BlobWriter();
+
+        BlobWriter(const BlobWriter&) = delete;
+        BlobWriter& operator=(const BlobWriter&) = delete;
+
+        const BlobStats& stats() const
+        {
+            return m_stats;
+        }
+
+        // Text BLOBs are converted to the connection character set by the server
+        void write(
+            Firebird::ThrowStatusWrapper* status,
+            Firebird::IAttachment* att,
+            Firebird::ITransaction* tra,
+            ISC_QUAD id,
+            bool text,
+            BlobEncoding encoding,
+            csv::CSVFile& csv);
+
+        // Reads the whole value, for the output formats that need it at once
+        void read(
+            Firebird::ThrowStatusWrapper* status,
+            Firebird::IAttachment* att,
+            Firebird::ITransaction* tra,
+            ISC_QUAD id,
+            std::string& value);
+    private:
+        // Reads the BLOB into the buffer after the first from bytes. Returns the number
+        // of bytes in the buffer, eof is set when the BLOB is over.
+        size_t fill(Firebird::ThrowStatusWrapper* status, Firebird::IBlob* blob, size_t from, bool& eof);
+    };
+
+} // namespace FBExport
+
+#endif // BLOB_FORMAT_H
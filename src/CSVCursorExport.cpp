@@ -21,98 +21,12 @@
  */
 
 #include "CSVCursorExport.h"
-#include "guid.h"
-#include <cstdarg>
-#include <sstream>
+#include "RowPipeline.h"
+#include <stdexcept>
 
 using namespace std;
 
 
-constexpr char WHITESPACE[] = " \n\r\t\f\v";
-
-std::string ltrim(const std::string& s)
-{
-	size_t start = s.find_first_not_of(WHITESPACE);
-	return (start == std::string::npos) ? "" : s.substr(start);
-}
-
-std::string rtrim(const std::string& s)
-{
-	size_t end = s.find_last_not_of(WHITESPACE);
-	return (end == std::string::npos) ? "" : s.substr(0, end + 1);
-}
-
-std::string trim(const std::string& s) {
-	return rtrim(ltrim(s));
-}
-
-static constexpr int64_t NUMERIC_FACTORS[] = {
-					  0, // 0
-					 10, // 1
-					100, // 2
-				   1000, // 3
-				  10000, // 4
-				 100000, // 5
-				1000000, // 6
-			   10000000, // 7
-			  100000000, // 8
-			 1000000000, // 9
-			10000000000, // 10
-		   100000000000, // 11
-		  1000000000000, // 12
-		 10000000000000, // 13
-		100000000000000, // 14
-	   1000000000000000, // 15
-	  10000000000000000, // 16
-	 100000000000000000, // 17
-	1000000000000000000  // 18
-};
-
-
-std::string vformat(const char* zcFormat, ...) 
-{
-
-	// initialize use of the variable argument array
-	va_list vaArgs;
-	va_start(vaArgs, zcFormat);
-
-	// reliably acquire the size
-	// from a copy of the variable argument array
-	// and a functionally reliable call to mock the formatting
-	va_list vaArgsCopy;
-	va_copy(vaArgsCopy, vaArgs);
-	const int iLen = std::vsnprintf(nullptr, 0, zcFormat, vaArgsCopy);
-	va_end(vaArgsCopy);
-
-	// return a formatted string without risking memory mismanagement
-	// and without assuming any compiler or platform specific behavior
-	std::vector<char> zc(iLen + 1);
-	std::vsnprintf(zc.data(), zc.size(), zcFormat, vaArgs);
-	va_end(vaArgs);
-	return std::string(zc.data(), iLen);
-}
-
-
-template <typename T>
-std::string getScaledInteger(const T value, short scale)
-{
-	auto factor = static_cast<T>(NUMERIC_FACTORS[-scale]);
-	auto int_value = value / factor;
-	auto frac_value = value % factor;
-	if (frac_value < 0) frac_value = -frac_value;
-	return vformat("%d.%0*d", int_value, -scale, frac_value);
-}
-
-std::string getBinaryString(const std::byte* data, size_t length)
-{
-	std::stringstream ss;
-	if (data) {
-		for (unsigned int i = 0; i < length; ++i)
-			ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(*data++);
-	}
-	return ss.str();
-}
-
 std::string escapeMetaName(const unsigned int sqlDialect, const std::string& name)
 {
 	if (name == "RDB$DB_KEY")
@@ -126,16 +40,51 @@ std::string escapeMetaName(const unsigned int sqlDialect, const std::string& nam
 	}
 }
 
-std::string buildSqlForTable(const std::string& tableName, const unsigned int sqlDialect, bool withDbkeyFilter)
+std::string buildSqlForTable(const std::string& tableName, const unsigned int sqlDialect, bool withDbkeyFilter, bool withDbKey)
 {
-	std::string sql = "SELECT * FROM " + escapeMetaName(sqlDialect, tableName);
+	const std::string relation = escapeMetaName(sqlDialect, tableName);
+	std::string sql = withDbKey
+		? "SELECT " + relation + ".*, RDB$DB_KEY FROM " + relation
+		: "SELECT * FROM " + relation;
 	if (withDbkeyFilter) {
-		sql += " WHERE RDB$DB_KEY >= MAKE_DBKEY('" + tableName + "', 0, 0, ?)";
-		sql += " AND RDB$DB_KEY < MAKE_DBKEY('" + tableName + "', 0, 0, ?)";
+		// the record number 0 with the data page and pointer page numbers
+		sql += " WHERE RDB$DB_KEY >= MAKE_DBKEY('" + tableName + "', 0, ?, ?)";
+		sql += " AND RDB$DB_KEY < MAKE_DBKEY('" + tableName + "', 0, ?, ?)";
 	}
 	return sql;
 }
 
+// Time zone values are requested together with the zone offset (the _EX types),
+// so they can be converted to local time without the time zone database.
+Firebird::IMessageMetadata* getExportMetadata(Firebird::ThrowStatusWrapper* status, Firebird::IMessageMetadata* metadata)
+{
+	Firebird::AutoRelease<Firebird::IMetadataBuilder> builder;
+	const unsigned count = metadata->getCount(status);
+	for (unsigned i = 0; i < count; i++) {
+		switch (metadata->getType(status, i)) {
+		case SQL_TIMESTAMP_TZ:
+			if (!builder) {
+				builder.reset(metadata->getBuilder(status));
+			}
+			builder->setType(status, i, SQL_TIMESTAMP_TZ_EX);
+			builder->setLength(status, i, sizeof(ISC_TIMESTAMP_TZ_EX));
+			break;
+		case SQL_TIME_TZ:
+			if (!builder) {
+				builder.reset(metadata->getBuilder(status));
+			}
+			builder->setType(status, i, SQL_TIME_TZ_EX);
+			builder->setLength(status, i, sizeof(ISC_TIME_TZ_EX));
+			break;
+		}
+	}
+	if (!builder) {
+		metadata->addRef();
+		return metadata;
+	}
+	return builder->getMetadata(status);
+}
+
 namespace FBExport 
 {
 	CSVExportTable::CSVExportTable(
@@ -146,30 +95,46 @@ namespace FBExport
 		: m_att(att)
 		, m_tra(tra)
 		, m_master(master)
-		, m_stmt{nullptr}
-		, m_tableName{""}
-		, m_sqlDialect(3)
-		, m_withDbkeyFilter(false)
-		, m_outMetadata{nullptr}
-		, m_fields()
+		, m_cache()
+		, m_cacheSize(DEFAULT_STATEMENT_CACHE_SIZE)
+		, m_current(nullptr)
+		, m_options()
+		, m_formatThreads(0)
+		, m_workStealing(false)
+		, m_blobs()
 	{
-		m_att->addRef();
-		m_tra->addRef();
+		// the replay of a capture works without the connection
+		if (m_att) {
+			m_att->addRef();
+		}
+		if (m_tra) {
+			m_tra->addRef();
+		}
 	}
 
 	void CSVExportTable::prepare(Firebird::ThrowStatusWrapper* status, const std::string& tableName, unsigned int sqlDialect, bool withDbkeyFilter)
 	{
-		// for same table not need repeat prepare
-		if (m_tableName == tableName) {
-			return;
+		const bool withDbKey = withDbkeyFilter && m_workStealing;
+		// the statement used recently is moved to the front without preparing
+		for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+			const auto& prepared = **it;
+			if (prepared.tableName == tableName && prepared.sqlDialect == sqlDialect &&
+				prepared.withDbkeyFilter == withDbkeyFilter && prepared.withDbKey == withDbKey)
+			{
+				m_cache.splice(m_cache.begin(), m_cache, it);
+				m_current = m_cache.front().get();
+				return;
+			}
 		}
 
-		m_tableName = tableName;
-		m_sqlDialect = sqlDialect;
-		m_withDbkeyFilter = withDbkeyFilter;
-		std::string sql = buildSqlForTable(tableName, sqlDialect, withDbkeyFilter);
+		auto prepared = std::make_unique<PreparedTable>();
+		prepared->tableName = tableName;
+		prepared->sqlDialect = sqlDialect;
+		prepared->withDbkeyFilter = withDbkeyFilter;
+		prepared->withDbKey = withDbKey;
+		std::string sql = buildSqlForTable(tableName, sqlDialect, withDbkeyFilter, withDbKey);
 
-		m_stmt.reset(m_att->prepare(
+		prepared->stmt.reset(m_att->prepare(
 			status,
 			m_tra,
 			0,
@@ -178,289 +143,315 @@ namespace FBExport
 			Firebird::IStatement::PREPARE_PREFETCH_METADATA
 		));
 
-		m_outMetadata.reset(m_stmt->getOutputMetadata(status));
-		Firebird::fillSQLDA(status, m_outMetadata, m_fields);
+		Firebird::AutoRelease<Firebird::IMessageMetadata> stmtMetadata(prepared->stmt->getOutputMetadata(status));
+		prepared->outMetadata.reset(getExportMetadata(status, stmtMetadata));
+		Firebird::fillSQLDA(status, prepared->outMetadata, prepared->fields);
+		Firebird::fillSQLDANames(status, prepared->outMetadata, prepared->names);
+		if (withDbKey) {
+			// the hidden column is not exported
+			prepared->dbKeyOffset = prepared->fields.back().offset;
+			prepared->fields.pop_back();
+			prepared->names.pop_back();
+		}
+		prepared->messageLength = prepared->outMetadata->getMessageLength(status);
+		prepared->plan.compile(prepared->fields);
+		if (m_binaryFormat != BinaryFormat::NONE) {
+			prepared->binaryPlan.compile(prepared->fields, m_binaryFormat);
+		}
+
+		// the least recently used statement is freed
+		while (m_cache.size() >= m_cacheSize) {
+			m_cache.pop_back();
+		}
+		m_cache.push_front(std::move(prepared));
+		m_current = m_cache.front().get();
+	}
+
+	void CSVExportTable::prepare(const CaptureHeader& header)
+	{
+		auto prepared = std::make_unique<PreparedTable>();
+		prepared->tableName = header.tableName;
+		prepared->messageLength = header.messageLength;
+		prepared->fields = header.fields;
+		prepared->names = header.names;
+		for (auto& field : prepared->fields) {
+			if (field.type == SQL_BLOB) {
+				field.type = SQL_NULL;
+			}
+		}
+		prepared->plan.compile(prepared->fields);
+		if (m_binaryFormat != BinaryFormat::NONE) {
+			prepared->binaryPlan.compile(prepared->fields, m_binaryFormat);
+		}
+		m_replayed = std::move(prepared);
+		m_current = m_replayed.get();
 	}
 
 	void CSVExportTable::printHeader(Firebird::ThrowStatusWrapper* status, csv::CSVFile& csv)
 	{
-		if (!m_stmt) {
+		if (!m_current) {
 			std::string message = "Statement not prepared";
 			ISC_STATUS statusVector[] = {isc_arg_gds, isc_random,
 			   isc_arg_string, (ISC_STATUS)message.c_str(),
 			   isc_arg_end };
 			status->setErrors(statusVector);
+			// setErrors of ThrowStatusWrapper does not throw
+			throw std::logic_error(message);
 		}
-		for (const auto& field : m_fields) {
-			csv << field.field;
+		for (const auto& name : m_current->names) {
+			csv << name.field;
 		}
 		csv << csv::endrow;
 	}
 
-	void CSVExportTable::printData(Firebird::ThrowStatusWrapper* status, csv::CSVFile& csv, int64_t ppNum)
+	Firebird::IResultSet* CSVExportTable::openCursor(Firebird::ThrowStatusWrapper* status, const PageRange& range, JobMetrics* job)
 	{
-		if (!m_stmt) {
-			std::string message = "Statement not prepared";
-			ISC_STATUS statusVector[] = { isc_arg_gds, isc_random,
-			   isc_arg_string, (ISC_STATUS)message.c_str(),
-			   isc_arg_end };
-			status->setErrors(statusVector);
-		}
-		std::vector<unsigned char> buffer(m_outMetadata->getMessageLength(status));
-
-		Firebird::AutoRelease<Firebird::IResultSet> rs;
-		if (m_withDbkeyFilter) {
+		const PreparedTable& prepared = *m_current;
+		// the cursor is executed by the server, so its opening is a part of the fetch time
+		const auto openStart = std::chrono::steady_clock::now();
+		Firebird::IResultSet* rs = nullptr;
+		if (prepared.withDbkeyFilter) {
 			InputMsgRecord input(status, m_master);
 
 			input.clear();
+			input->lowerDPNull = false;
+			input->lowerDP = range.lowerDP;
 			input->lowerPPNull = false;
-			input->lowerPP = ppNum;
+			input->lowerPP = range.lowerPP;
+			input->upperDPNull = false;
+			input->upperDP = range.upperDP;
 			input->upperPPNull = false;
-			input->upperPP = ppNum + 1;
-
-
-			rs.reset(
-				m_stmt->openCursor(
-					status,
-					m_tra,
-					input.getMetadata(),
-					input.getData(),
-					m_outMetadata,
-					0)
-			);
+			input->upperPP = range.upperPP;
+
+
+			rs = prepared.stmt->openCursor(
+				status,
+				m_tra,
+				input.getMetadata(),
+				input.getData(),
+				prepared.outMetadata,
+				0);
 		}
 		else {
-			rs.reset(
-				m_stmt->openCursor(
-					status,
-					m_tra,
-					nullptr,
-					nullptr,
-					m_outMetadata,
-					0)
-			);
+			rs = prepared.stmt->openCursor(
+				status,
+				m_tra,
+				nullptr,
+				nullptr,
+				prepared.outMetadata,
+				0);
 		}
 
-		exportResultSet(status, rs, buffer.data(), csv);
+		if (job && m_timed) {
+			job->fetchTime += std::chrono::steady_clock::now() - openStart;
+		}
+		return rs;
+	}
+
+	void CSVExportTable::printData(
+		Firebird::ThrowStatusWrapper* status, 
+		csv::CSVFile& csv, 
+		const PageRange& range, 
+		SharedRange* shared,
+		JobMetrics* job)
+	{
+		if (!m_current) {
+			std::string message = "Statement not prepared";
+			ISC_STATUS statusVector[] = { isc_arg_gds, isc_random,
+			   isc_arg_string, (ISC_STATUS)message.c_str(),
+			   isc_arg_end };
+			status->setErrors(statusVector);
+			// setErrors of ThrowStatusWrapper does not throw
+			throw std::logic_error(message);
+		}
+		const PreparedTable& prepared = *m_current;
+		std::vector<unsigned char> buffer(prepared.messageLength);
+		Firebird::AutoRelease<Firebird::IResultSet> rs(openCursor(status, range, job));
+
+		CursorSource cursor(rs);
+		if (m_capture) {
+			m_capture->begin(prepared.fields, prepared.names, prepared.messageLength);
+			CaptureSource capture(cursor, *m_capture);
+			exportResultSet(status, capture, buffer.data(), csv, prepared.withDbKey ? shared : nullptr, job);
+		}
+		else {
+			exportResultSet(status, cursor, buffer.data(), csv, prepared.withDbKey ? shared : nullptr, job);
+		}
 
 		rs->close(status);
 		rs.release();
 	}
 
-	void CSVExportTable::exportResultSet(
+	void CSVExportTable::printRows(
+		Firebird::ThrowStatusWrapper* status,
+		csv::CSVFile& csv,
+		RowSource& source,
+		JobMetrics* job)
+	{
+		if (!m_current) {
+			std::string message = "Statement not prepared";
+			ISC_STATUS statusVector[] = { isc_arg_gds, isc_random,
+			   isc_arg_string, (ISC_STATUS)message.c_str(),
+			   isc_arg_end };
+			status->setErrors(statusVector);
+			// setErrors of ThrowStatusWrapper does not throw
+			throw std::logic_error(message);
+		}
+		std::vector<unsigned char> buffer(m_current->messageLength);
+		exportResultSet(status, source, buffer.data(), csv, nullptr, job);
+	}
+
+	template <typename WriteRow>
+	void CSVExportTable::fetchRows(
 			Firebird::ThrowStatusWrapper* status,
-			Firebird::IResultSet* rs,
+			RowSource& source,
 			unsigned char* buffer,
-			csv::CSVFile& csv)
+			SharedRange* shared,
+			RowMeter& meter,
+			WriteRow writeRow)
 	{
-		auto fbUtil = m_master->getUtilInterface();
-		auto i128 = fbUtil->getInt128(status);
-		auto df16 = fbUtil->getDecFloat16(status);
-		auto df34 = fbUtil->getDecFloat34(status);
-
-		while (rs->fetchNext(status, buffer) == Firebird::IStatus::RESULT_OK)
-		{
-			for (const auto& field : m_fields) {
-				short nullFlag = *reinterpret_cast<short*>(buffer + field.nullOffset);
-				if (nullFlag) {
-					csv << nullptr;
-					continue;
-				}
-				unsigned char* valuePtr = reinterpret_cast<unsigned char*>(buffer + field.offset);
-				switch (field.type) {
-				case SQL_BOOLEAN:
-				{
-					auto value = *reinterpret_cast<unsigned char*>(valuePtr);
-					csv << (value ? "1" : "0");
-					break;
-				}
-				case SQL_TEXT:
-				{
-					if (field.charset == 1) {
-						if (field.length == 16) {
-							// special case BINARY(16) as GUID
-							auto guid = reinterpret_cast<Firebird::Guid*>(valuePtr);
-							char guidBuff[Firebird::GUID_BUFF_SIZE + 1] = { 0 };
-							Firebird::GuidToString(guidBuff, guid);
-							csv.write(guidBuff);
-						}
-						else {
-							// BINARY(N)
-							std::byte* b = reinterpret_cast<std::byte*>(valuePtr);
-							csv << rtrim(getBinaryString(b, field.length));
-						}
-					}
-					else {
-						// CHAR(N)
-						std::string s(reinterpret_cast<char*>(valuePtr), field.length);
-						csv << rtrim(s);
-					}
-					break;
-				}
-				case SQL_VARYING:
-				{
-					if (field.charset == 1) {
-						// VARBINARY(N)
-						auto len = *reinterpret_cast<unsigned short*>(valuePtr);
-						std::byte* b = reinterpret_cast<std::byte*>(valuePtr + 2);
-						csv << getBinaryString(b, len);
-					}
-					else {
-						// VARCHAR(N)
-						auto len = *reinterpret_cast<unsigned short*>(valuePtr);
-						std::string s(reinterpret_cast<char*>(valuePtr + 2), len);
-						csv << s;
-					}
-					break;
-				}
-				case SQL_SHORT:
-				{
-					auto value = *reinterpret_cast<short*>(valuePtr);
-					if (field.scale == 0) {
-						csv << value;
-					}
-					else {
-						csv.write(getScaledInteger(value, static_cast<short>(field.scale)));
-					}
-					break;
-				}
-				case SQL_LONG:
-				{
-					auto value = *reinterpret_cast<int*>(valuePtr);
-					if (field.scale == 0) {
-						csv << value;
-					}
-					else {
-						csv.write(getScaledInteger(value, static_cast<short>(field.scale)));
-					}
-					break;
-				}
-				case SQL_INT64:
-				{
-					auto value = *reinterpret_cast<int64_t*>(valuePtr);
-					if (field.scale == 0) {
-
-						csv << value;
-					}
-					else {
-						csv.write(getScaledInteger(value, static_cast<short>(field.scale)));
-					}
-					break;
-				}
-				case SQL_INT128:
-				{
-					auto i128Ptr = reinterpret_cast<FB_I128_t*>(valuePtr);
-					std::string s;
-					s.reserve(Firebird::IInt128::STRING_SIZE);
-					i128->toString(status, i128Ptr, field.scale, Firebird::IInt128::STRING_SIZE, s.data());
-					csv.write(s);
-					break;
-				}
-				case SQL_FLOAT:
-				{
-					auto value = *reinterpret_cast<float*>(valuePtr);
-					csv << value;
-					break;
-				}
-				case SQL_D_FLOAT:
-				case SQL_DOUBLE:
-				{
-					auto value = *reinterpret_cast<double*>(valuePtr);
-					csv << value;
-					break;
-				}
-				case SQL_TYPE_DATE:
-				{
-					auto value = *reinterpret_cast<ISC_DATE*>(valuePtr);
-					unsigned int year, month, day;
-					fbUtil->decodeDate(value, &year, &month, &day);
-					auto s = vformat("%d-%02d-%02d", year, month, day);
-					csv.write(s);
-					break;
-				}
-				case SQL_TYPE_TIME:
-				{
-					auto value = *reinterpret_cast<ISC_TIME*>(valuePtr);
-					unsigned int hours, minutes, seconds, fractions;
-					fbUtil->decodeTime(value, &hours, &minutes, &seconds, &fractions);
-					auto s = vformat("%02d:%02d:%02d.%04d", hours, minutes, seconds, fractions);
-					csv.write(s);
-					break;
-				}
-				case SQL_TIMESTAMP:
-				{
-					auto value = *reinterpret_cast<ISC_TIMESTAMP*>(valuePtr);
-					unsigned int year, month, day;
-					fbUtil->decodeDate(value.timestamp_date, &year, &month, &day);
-					unsigned int hours, minutes, seconds, fractions;
-					fbUtil->decodeTime(value.timestamp_time, &hours, &minutes, &seconds, &fractions);
-					auto s = vformat("%d-%02d-%02d %02d:%02d:%02d.%04d", year, month, day, hours, minutes, seconds, fractions);
-					csv.write(s);
-					break;
-				}
-				case SQL_DEC16:
-				{
-					auto decValuePtr = reinterpret_cast<FB_DEC16_t*>(valuePtr);
-					char decBuffer[Firebird::IDecFloat16::STRING_SIZE + 1] = { 0 };
-					df16->toString(status, decValuePtr, Firebird::IDecFloat16::STRING_SIZE, decBuffer);
-					csv.write(&decBuffer[0]);
-					break;
-				}
-				case SQL_DEC34:
-				{
-					auto decValuePtr = reinterpret_cast<FB_DEC34_t*>(valuePtr);
-					char decBuffer[Firebird::IDecFloat34::STRING_SIZE + 1] = { 0 };
-					df34->toString(status, decValuePtr, Firebird::IDecFloat34::STRING_SIZE, decBuffer);
-					csv.write(&decBuffer[0]);
-					break;
-				}
-				case SQL_TIMESTAMP_TZ:
-				{
-					auto tsPtr = reinterpret_cast<ISC_TIMESTAMP_TZ*>(valuePtr);
-					unsigned int year, month, day;
-					unsigned int hours, minutes, seconds, fractions;
-					char tsBuffer[32] = { 0 };
-					fbUtil->decodeTimeStampTz(
-						status, tsPtr,
-						&year, &month, &day,
-						&hours, &minutes, &seconds, &fractions,
-					    static_cast<unsigned int>(std::size(tsBuffer)), 
-						tsBuffer
-					);
-					auto s = vformat("%d-%02d-%02d %02d:%02d:%02d.%04d %s", year, month, day, hours, minutes, seconds, fractions, tsBuffer);
-					csv.write(s);
-					break;
-				}
-				case SQL_TIME_TZ:
-				{
-					auto tsPtr = reinterpret_cast<ISC_TIME_TZ*>(valuePtr);
-					unsigned int hours, minutes, seconds, fractions;
-					char tsBuffer[32] = { 0 };
-					fbUtil->decodeTimeTz(
-						status, tsPtr,
-						&hours, &minutes, &seconds, &fractions,
-						static_cast<unsigned int>(std::size(tsBuffer)),
-						tsBuffer
-					);
-					auto s = vformat("%02d:%02d:%02d.%04d %s", hours, minutes, seconds, fractions, tsBuffer);
-					csv.write(s);
-					break;
-				}
-				case SQL_BLOB:
-				{
-					// can not support export blob data, 
-					csv << nullptr;
-					break;
-				}
-				case SQL_ARRAY:
-				{
-					// can not support export array data, 
-					csv << nullptr;
+		if (shared) {
+			const unsigned char* dbKey = buffer + m_current->dbKeyOffset;
+			while (source.fetch(status, buffer))
+			{
+				meter.fetched();
+				if (!shared->accept(decodeDbKey(dbKey))) {
 					break;
 				}
-				}
+				writeRow(buffer);
+				meter.formatted();
+				meter.row();
+			}
+		}
+		else {
+			while (source.fetch(status, buffer))
+			{
+				meter.fetched();
+				writeRow(buffer);
+				meter.formatted();
+				meter.row();
 			}
-			csv << csv::endrow;
 		}
 	}
+
+	void CSVExportTable::exportResultSet(
+			Firebird::ThrowStatusWrapper* status,
+			RowSource& source,
+			unsigned char* buffer,
+			csv::CSVFile& csv,
+			SharedRange* shared,
+			JobMetrics* job)
+	{
+		RowMeter meter(job, m_progressRows, m_timed);
+
+		// BLOB values are read by the fetching thread, the pipeline formatters have no connection.
+		// The binary values are copied from the message, there is little to do in parallel.
+		if (m_formatThreads > 0 && !m_current->plan.hasBlobs() && m_binaryFormat == BinaryFormat::NONE) {
+			RowPipeline pipeline(m_master, m_current->plan, m_options, m_current->messageLength, m_formatThreads);
+			if (shared) {
+				const unsigned dbKeyOffset = m_current->dbKeyOffset;
+				pipeline.run(status, source, csv, meter, [shared, dbKeyOffset](const unsigned char* message) {
+					return shared->accept(decodeDbKey(message + dbKeyOffset));
+				});
+			}
+			else {
+				pipeline.run(status, source, csv, meter);
+			}
+			return;
+		}
+
+		const FormatPlan& plan = m_current->plan;
+		FormatContext ctx(status, m_master, m_options);
+		ctx.att = m_att;
+		ctx.tra = m_tra;
+		ctx.blobs = &m_blobs;
+
+		// the buffer writes happen inside formatRow, they are counted as the write time
+		const auto writeStart = csv.buffer().writeTime();
+		if (m_binaryFormat != BinaryFormat::NONE) {
+			const BinaryPlan& binaryPlan = m_current->binaryPlan;
+			fetchRows(status, source, buffer, shared, meter, [&](const unsigned char* message) {
+				binaryPlan.writeRow(ctx, message, csv.buffer());
+			});
+		}
+		else {
+			fetchRows(status, source, buffer, shared, meter, [&](const unsigned char* message) {
+				plan.formatRow(ctx, message, csv);
+			});
+		}
+		meter.addFormatTime(writeStart - csv.buffer().writeTime());
+	}
+
+	void CSVExportTable::printData(
+		Firebird::ThrowStatusWrapper* status,
+		ParquetFile& parquet,
+		const PageRange& range,
+		JobMetrics* job)
+	{
+		if (!m_current) {
+			std::string message = "Statement not prepared";
+			ISC_STATUS statusVector[] = { isc_arg_gds, isc_random,
+			   isc_arg_string, (ISC_STATUS)message.c_str(),
+			   isc_arg_end };
+			status->setErrors(statusVector);
+			// setErrors of ThrowStatusWrapper does not throw
+			throw std::logic_error(message);
+		}
+		const PreparedTable& prepared = *m_current;
+		std::vector<unsigned char> buffer(prepared.messageLength);
+		Firebird::AutoRelease<Firebird::IResultSet> rs(openCursor(status, range, job));
+
+		CursorSource cursor(rs);
+		if (m_capture) {
+			m_capture->begin(prepared.fields, prepared.names, prepared.messageLength);
+			CaptureSource capture(cursor, *m_capture);
+			exportResultSet(status, capture, buffer.data(), parquet, job);
+		}
+		else {
+			exportResultSet(status, cursor, buffer.data(), parquet, job);
+		}
+
+		rs->close(status);
+		rs.release();
+	}
+
+	void CSVExportTable::printRows(
+		Firebird::ThrowStatusWrapper* status,
+		ParquetFile& parquet,
+		RowSource& source,
+		JobMetrics* job)
+	{
+		if (!m_current) {
+			std::string message = "Statement not prepared";
+			ISC_STATUS statusVector[] = { isc_arg_gds, isc_random,
+			   isc_arg_string, (ISC_STATUS)message.c_str(),
+			   isc_arg_end };
+			status->setErrors(statusVector);
+			// setErrors of ThrowStatusWrapper does not throw
+			throw std::logic_error(message);
+		}
+		std::vector<unsigned char> buffer(m_current->messageLength);
+		exportResultSet(status, source, buffer.data(), parquet, job);
+	}
+
+	void CSVExportTable::exportResultSet(
+			Firebird::ThrowStatusWrapper* status,
+			RowSource& source,
+			unsigned char* buffer,
+			ParquetFile& parquet,
+			JobMetrics* job)
+	{
+		RowMeter meter(job, m_progressRows, m_timed);
+		FormatContext ctx(status, m_master, m_options);
+		ctx.att = m_att;
+		ctx.tra = m_tra;
+		ctx.blobs = &m_blobs;
+
+		// the columns are encoded in memory, the buffer is written when a row group is complete
+		const auto writeStart = parquet.buffer().writeTime();
+		fetchRows(status, source, buffer, nullptr, meter, [&](const unsigned char* message) {
+			parquet.writeRow(ctx, message);
+		});
+		meter.addFormatTime(writeStart - parquet.buffer().writeTime());
+	}
 } // namespace FBExport
@@ -27,29 +27,68 @@
 
 #include "CSVFile.h"
 #include "sqlda.h"
+#include "FormatPlan.h"
+#include "DbKeyRange.h"
+#include "ExportMetrics.h"
+#include "RowCapture.h"
+#include "ParquetFile.h"
+#include "BinaryFormat.h"
 #include <firebird/Interface.h>
 #include <firebird/Message.h>
 #include "FBAutoPtr.h"
 #include <string>
+#include <list>
+#include <memory>
 
 namespace FBExport
 {
+    // Prepared statements kept by each export thread
+    inline constexpr size_t DEFAULT_STATEMENT_CACHE_SIZE = 16;
+
     class CSVExportTable
     {
         FB_MESSAGE(InputMsgRecord, Firebird::ThrowStatusWrapper,
+            (FB_BIGINT, lowerDP)
             (FB_BIGINT, lowerPP)
+            (FB_BIGINT, upperDP)
             (FB_BIGINT, upperPP)
         );
 
+        // Statement of one table with its output format
+        struct PreparedTable
+        {
+            std::string tableName;
+            unsigned int sqlDialect = 3;
+            bool withDbkeyFilter = false;
+            // the hidden RDB$DB_KEY column of the work stealing mode
+            bool withDbKey = false;
+            unsigned dbKeyOffset = 0;
+            unsigned messageLength = 0;
+            Firebird::AutoRelease<Firebird::IStatement> stmt;
+            Firebird::AutoRelease<Firebird::IMessageMetadata> outMetadata;
+            Firebird::SQLDAList fields;
+            Firebird::SQLDANameList names;
+            FormatPlan plan;
+            BinaryPlan binaryPlan;
+        };
+
         Firebird::AutoRelease<Firebird::IAttachment> m_att;
         Firebird::AutoRelease<Firebird::ITransaction> m_tra;
         Firebird::IMaster* m_master = nullptr;
-        Firebird::AutoRelease<Firebird::IStatement> m_stmt;
-        std::string m_tableName{ "" };
-        unsigned int m_sqlDialect = 3;
-        bool m_withDbkeyFilter = false;
-        Firebird::AutoRelease<Firebird::IMessageMetadata> m_outMetadata;
-        Firebird::SQLDAList m_fields;
+        // recently used statements, the current one is the first
+        std::list<std::unique_ptr<PreparedTable>> m_cache;
+        size_t m_cacheSize = DEFAULT_STATEMENT_CACHE_SIZE;
+        PreparedTable* m_current = nullptr;
+        // the table of the capture file, it has no statement
+        std::unique_ptr<PreparedTable> m_replayed;
+        FormatOptions m_options;
+        BinaryFormat m_binaryFormat = BinaryFormat::NONE;
+        unsigned m_formatThreads = 0;
+        bool m_workStealing = false;
+        BlobWriter m_blobs;
+        std::atomic<uint64_t>* m_progressRows = nullptr;
+        bool m_timed = false;
+        CaptureWriter* m_capture = nullptr;
     public: 
         CSVExportTable(
             Firebird::IAttachment* att,
@@ -57,17 +96,135 @@ namespace FBExport
             Firebird::IMaster* master
         );
 
+        void setFormatOptions(const FormatOptions& options)
+        {
+            m_options = options;
+        }
+
+        // The rows are written in the binary format instead of CSV. Must be set before
+        // the first prepare, the statement cache keeps the plans of one format.
+        void setBinaryFormat(BinaryFormat format)
+        {
+            m_binaryFormat = format;
+        }
+
+        // With the dbkey filter the statement also returns RDB$DB_KEY of each record,
+        // so printData can stop at the bound moved by another worker
+        void setWorkStealing(bool workStealing)
+        {
+            m_workStealing = workStealing;
+        }
+
+        const BlobStats& blobStats() const
+        {
+            return m_blobs.stats();
+        }
+
+        // Number of formatter threads of the fetch/format/write pipeline, 0 disables it.
+        // The tables with BLOB columns and the binary formats are exported without the pipeline.
+        void setFormatThreads(unsigned formatThreads)
+        {
+            m_formatThreads = formatThreads;
+        }
+
+        // Rows are added to the progress totals, the times are measured for the report
+        void setMetrics(ExportMetrics& metrics)
+        {
+            m_progressRows = metrics.progressRows();
+            m_timed = metrics.timed();
+        }
+
+        // The messages fetched by the next printData are also saved to the capture
+        void setCapture(CaptureWriter* capture)
+        {
+            m_capture = capture;
+        }
+
+        // Number of prepared statements kept for the tables exported before, at least 1
+        void setStatementCacheSize(size_t cacheSize)
+        {
+            m_cacheSize = cacheSize > 0 ? cacheSize : 1;
+        }
+
+        // Takes the statement from the cache or prepares it. The statements differ by the table,
+        // the dialect, the dbkey filter and the hidden RDB$DB_KEY column.
         void prepare(Firebird::ThrowStatusWrapper* status, const std::string& tableName, unsigned int sqlDialect, bool withDbkeyFilter = false);
 
+        // Takes the output format from the capture file instead of the statement.
+        // BLOB identifiers have no meaning without the connection, such columns are exported as empty values.
+        void prepare(const CaptureHeader& header);
+
+        // Output columns of the current table
+        const Firebird::SQLDAList& fields() const
+        {
+            return m_current->fields;
+        }
+
+        const Firebird::SQLDANameList& names() const
+        {
+            return m_current->names;
+        }
+
         void printHeader(Firebird::ThrowStatusWrapper* status, csv::CSVFile& csv);
 
-        void printData(Firebird::ThrowStatusWrapper* status, csv::CSVFile& csv, int64_t ppNum = 0);
+        // With the dbkey filter only the records of the given range are exported.
+        // In the work stealing mode the export stops at the upper bound of the shared range.
+        // The rows and the fetch and format times are added to the job metrics.
+        void printData(
+            Firebird::ThrowStatusWrapper* status, 
+            csv::CSVFile& csv, 
+            const PageRange& range = PageRange(), 
+            SharedRange* shared = nullptr,
+            JobMetrics* job = nullptr);
+
+        // Exports the messages of the source in the format of the current table
+        void printRows(
+            Firebird::ThrowStatusWrapper* status,
+            csv::CSVFile& csv,
+            RowSource& source,
+            JobMetrics* job = nullptr);
+        // Same as above for the Parquet output. The rows are fetched and encoded by one
+        // thread, neither the pipeline nor the work stealing is used.
+        void printData(
+            Firebird::ThrowStatusWrapper* status,
+            ParquetFile& parquet,
+            const PageRange& range = PageRange(),
+            JobMetrics* job = nullptr);
+
+        void printRows(
+            Firebird::ThrowStatusWrapper* status,
+            ParquetFile& parquet,
+            RowSource& source,
+            JobMetrics* job = nullptr);
     private:
+        // The cursor of the current table, the opening time is added to the job fetch time
+        Firebird::IResultSet* openCursor(Firebird::ThrowStatusWrapper* status, const PageRange& range, JobMetrics* job);
+
         void exportResultSet(
             Firebird::ThrowStatusWrapper* status,
-            Firebird::IResultSet* rs,
+            RowSource& source,
+            unsigned char* buffer,
+            csv::CSVFile& csv,
+            SharedRange* shared,
+            JobMetrics* job);
+
+        void exportResultSet(
+            Firebird::ThrowStatusWrapper* status,
+            RowSource& source,
+            unsigned char* buffer,
+            ParquetFile& parquet,
+            JobMetrics* job);
+
+        // The fetch loop of the CSV and binary formats, writeRow is called for each message.
+        // In the work stealing mode the loop stops at the upper bound of the shared range.
+        template <typename WriteRow>
+        void fetchRows(
+            Firebird::ThrowStatusWrapper* status,
+            RowSource& source,
             unsigned char* buffer,
-            csv::CSVFile& csv);
+            SharedRange* shared,
+            RowMeter& meter,
+            WriteRow writeRow);
     };
 
 } // namespace FBExport
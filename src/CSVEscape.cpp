@@ -0,0 +1,188 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "CSVEscape.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define CSV_ESCAPE_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+    inline bool isSpecialChar(char c, char separator)
+    {
+        return c == '"' || c == separator || c == '\n' || c == '\r';
+    }
+
+    size_t findSpecialScalar(const char* data, size_t from, size_t size, char separator)
+    {
+        for (size_t i = from; i < size; i++) {
+            if (isSpecialChar(data[i], separator)) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+#ifdef CSV_ESCAPE_SSE2
+
+    inline unsigned countTrailingZeros(unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    size_t findSpecialSSE2(const char* data, size_t size, char separator)
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i sep = _mm_set1_epi8(separator);
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, sep)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf))
+            );
+            const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+        return findSpecialScalar(data, i, size, separator);
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((target("avx2")))
+#endif
+    size_t findSpecialAVX2(const char* data, size_t size, char separator)
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i sep = _mm256_set1_epi8(separator);
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const __m256i hits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, sep)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr), _mm256_cmpeq_epi8(chunk, lf))
+            );
+            const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+            if (mask) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+        if (i < size) {
+            return i + findSpecialSSE2(data + i, size - i, separator);
+        }
+        return size;
+    }
+
+    bool cpuHasAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        // OSXSAVE and AVX, then the OS must save the YMM registers
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+            return false;
+        }
+        if ((_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    using FindSpecialFunc = size_t(*)(const char*, size_t, char);
+
+#endif // CSV_ESCAPE_SSE2
+} // namespace
+
+namespace csv
+{
+
+    size_t findSpecialChar(const char* data, size_t size, char separator)
+    {
+#ifdef CSV_ESCAPE_SSE2
+        // the implementation is chosen once
+        static const FindSpecialFunc findSpecialImpl = cpuHasAVX2() ? findSpecialAVX2 : findSpecialSSE2;
+        return findSpecialImpl(data, size, separator);
+#else
+        return findSpecialScalar(data, 0, size, separator);
+#endif
+    }
+
+    void writeEscaped(OutputBuffer& buffer, const char* data, size_t size, char separator)
+    {
+        size_t pos = size > 0 ? findSpecialChar(data, size, separator) : 0;
+        if (pos == size && size > 0) {
+            // the most frequent case, nothing to quote
+            buffer.append(data, size);
+            return;
+        }
+        buffer.put('"');
+        // the part before the first special character has no quotes
+        buffer.append(data, pos);
+        writeQuotedPart(buffer, data + pos, size - pos);
+        buffer.put('"');
+    }
+
+    void writeQuotedPart(OutputBuffer& buffer, const char* data, size_t size)
+    {
+        // only the quotes need to be doubled, everything else is written as is
+        size_t from = 0;
+        while (from < size) {
+            auto quote = static_cast<const char*>(std::memchr(data + from, '"', size - from));
+            if (!quote) {
+                break;
+            }
+            size_t to = static_cast<size_t>(quote - data) + 1;
+            buffer.append(data + from, to - from);
+            buffer.put('"');
+            from = to;
+        }
+        buffer.append(data + from, size - from);
+    }
+
+} // namespace csv
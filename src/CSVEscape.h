@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef CSV_ESCAPE_H
+#define CSV_ESCAPE_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <cstddef>
+#include "OutputBuffer.h"
+
+namespace csv
+{
+    // Returns the position of the first character that forces the value to be quoted
+    // (double quote, separator, CR or LF), or size if there is none.
+    // The scan is done with AVX2 or SSE2 when the processor supports it.
+    size_t findSpecialChar(const char* data, size_t size, char separator);
+
+    // Writes the value to the buffer as a CSV field according to RFC 4180.
+    // The value is quoted only when it is needed, the quotes inside it are doubled.
+    // An empty string is written as "" to distinguish it from NULL.
+    void writeEscaped(OutputBuffer& buffer, const char* data, size_t size, char separator);
+
+    // Writes a part of a quoted value with the quotes doubled. The opening and the closing
+    // quotes are written by the caller, so a value of any length can be written in parts.
+    void writeQuotedPart(OutputBuffer& buffer, const char* data, size_t size);
+
+} // namespace csv
+
+#endif // CSV_ESCAPE_H
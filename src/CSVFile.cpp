@@ -21,40 +21,72 @@
  */
 
 #include "CSVFile.h"
-#include <sstream>
 
 using namespace csv;
 
 CSVFile::CSVFile(const fs::path& filename, const std::string separator)
-    : fs_(filename) 
+    : own_buffer_(std::make_unique<OutputBuffer>())
+    , buffer_(*own_buffer_)
+    , own_sink_(std::make_unique<FileSink>(filename, buffer_.stats()))
+    , sink_(*own_sink_)
     , is_first_(true)
-    , separator_(separator)
-    , escape_seq_("\"")
-    , special_chars_("\"")
+    , closed_(false)
+    , separator_(separator.empty() ? ',' : separator[0])
 {
-    fs_.exceptions(std::ios::failbit | std::ios::badbit);
-    //fs_.open(filename);
+    buffer_.attach(&sink_);
+}
+
+CSVFile::CSVFile(const fs::path& filename, OutputBuffer& buffer, const std::string separator)
+    : own_buffer_(nullptr)
+    , buffer_(buffer)
+    , own_sink_(std::make_unique<FileSink>(filename, buffer_.stats()))
+    , sink_(*own_sink_)
+    , is_first_(true)
+    , closed_(false)
+    , separator_(separator.empty() ? ',' : separator[0])
+{
+    buffer_.attach(&sink_);
+}
+
+CSVFile::CSVFile(OutputSink& sink, OutputBuffer& buffer, const std::string separator)
+    : own_buffer_(nullptr)
+    , buffer_(buffer)
+    , own_sink_(nullptr)
+    , sink_(sink)
+    , is_first_(true)
+    , closed_(false)
+    , separator_(separator.empty() ? ',' : separator[0])
+{
+    buffer_.attach(&sink_);
 }
 
 CSVFile::~CSVFile()
 {
-    flush();
-    fs_.close();
+    if (!closed_) {
+        // errors must be caught by an explicit call to close()
+        try {
+            close();
+        }
+        catch (...) {
+        }
+    }
 }
 
-std::string CSVFile::escape(const std::string& val)
+void CSVFile::close()
 {
-    std::ostringstream result;
-    result << '"';
-    std::string::size_type to, from = 0u, len = val.length();
-    while (from < len &&
-        std::string::npos != (to = val.find_first_of(special_chars_, from)))
-    {
-        result << val.substr(from, to - from) << escape_seq_ << val[to];
-        from = to + 1;
+    closed_ = true;
+    try {
+        buffer_.detach();
+    }
+    catch (...) {
+        // the buffer may be reused for the next file
+        buffer_.reset();
+        throw;
+    }
+    // an external sink is closed by its owner
+    if (own_sink_) {
+        own_sink_->close();
     }
-    result << val.substr(from) << '"';
-    return result.str();
 }
 
 namespace csv
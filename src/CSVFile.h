@@ -26,9 +26,15 @@
  */
 
 #include <string>
-#include <iostream>
-#include <fstream>
+#include <cstring>
+#include <string_view>
+#include <charconv>
+#include <memory>
+#include <type_traits>
+#include <limits>
 #include <filesystem>
+#include "OutputBuffer.h"
+#include "CSVEscape.h"
 
 namespace fs = std::filesystem;
 
@@ -36,24 +42,44 @@ namespace csv
 {
 	class CSVFile
 	{
-        std::ofstream fs_;
+        std::unique_ptr<OutputBuffer> own_buffer_;
+        OutputBuffer& buffer_;
+        std::unique_ptr<FileSink> own_sink_;
+        OutputSink& sink_;
         bool is_first_;
-        const std::string separator_;
-        const std::string escape_seq_;
-        const std::string special_chars_;
+        bool closed_;
+        const char separator_;
     public:
         CSVFile(const fs::path& filename, const std::string separator = ";");
 
+        // The file uses an external buffer, for example one owned by an export worker.
+        CSVFile(const fs::path& filename, OutputBuffer& buffer, const std::string separator = ";");
+
+        // The data is passed to an arbitrary sink instead of a file
+        CSVFile(OutputSink& sink, OutputBuffer& buffer, const std::string separator = ";");
+
         ~CSVFile();
 
+        OutputBuffer& buffer()
+        {
+            return buffer_;
+        }
+
+        char separator() const
+        {
+            return separator_;
+        }
+
         void flush()
         {
-            fs_.flush();
+            buffer_.flush();
         }
 
+        void close();
+
         void endrow()
         {
-            fs_ << std::endl;
+            buffer_.put('\n');
             is_first_ = true;
         }
 
@@ -64,17 +90,25 @@ namespace csv
 
         CSVFile& operator << (const char* val)
         {
-            return write(escape(val));
+            return writeString(val, std::strlen(val));
         }
 
         CSVFile& operator << (const std::string& val)
         {
-            return write(escape(val));
+            return writeString(val.data(), val.size());
+        }
+
+        // Writes a string value, quoting it when required
+        CSVFile& writeString(const char* data, size_t size)
+        {
+            nextField();
+            writeEscaped(buffer_, data, size, separator_);
+            return *this;
         }
 
         CSVFile& operator << ([[maybe_unused]] std::nullptr_t val)
         {
-            return write("");
+            return write(std::string_view());
         }
 
         template<typename T>
@@ -83,23 +117,81 @@ namespace csv
             return write(val);
         }
 
+        // Starts a new field and returns a pointer where at least n bytes of its value
+        // can be written. The field must be completed by commitField().
+        char* reserveField(size_t n)
+        {
+            nextField();
+            return buffer_.reserve(n);
+        }
+
+        void commitField(const char* end)
+        {
+            buffer_.commitTo(end);
+        }
+
+        // Continues the field started by reserveField(), for values written in parts.
+        // The part must be completed by commitField().
+        char* extendField(size_t n)
+        {
+            return buffer_.reserve(n);
+        }
+
+        // A quoted value written in parts: beginQuoted(), writeQuoted() for each part
+        // and endQuoted(). It is used when the value is too long to be checked at once.
+        void beginQuoted()
+        {
+            nextField();
+            buffer_.put('"');
+        }
+
+        void writeQuoted(const char* data, size_t size)
+        {
+            writeQuotedPart(buffer_, data, size);
+        }
+
+        void endQuoted()
+        {
+            buffer_.put('"');
+        }
+
         template<typename T>
         CSVFile& write(const T& val)
+        {
+            nextField();
+            if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                std::string_view s(val);
+                buffer_.append(s.data(), s.size());
+            }
+            else if constexpr (std::is_integral_v<T>) {
+                constexpr size_t maxLen = std::numeric_limits<T>::digits10 + 3;
+                char* first = buffer_.reserve(maxLen);
+                auto [last, ec] = std::to_chars(first, first + maxLen, val);
+                buffer_.commit(static_cast<size_t>(last - first));
+            }
+            else {
+                static_assert(std::is_floating_point_v<T>, "unsupported CSV value type");
+                // shortest representation that reads back to the same value
+                constexpr size_t maxLen = 32;
+                char* first = buffer_.reserve(maxLen);
+                auto [last, ec] = std::to_chars(first, first + maxLen, val);
+                buffer_.commit(static_cast<size_t>(last - first));
+            }
+            return *this;
+        }
+    private:
+
+        void nextField()
         {
             if (!is_first_)
             {
-                fs_ << separator_;
+                buffer_.put(separator_);
             }
             else
             {
                 is_first_ = false;
             }
-            fs_ << val;
-            return *this;
         }
-    private:
-
-        std::string escape(const std::string& val);
 	};
 
     CSVFile& endrow(CSVFile& file);
@@ -0,0 +1,259 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "CompressSink.h"
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace csv
+{
+
+    namespace
+    {
+#ifdef HAVE_ZLIB
+        void compressGzip(int level, const char* data, size_t size, std::vector<char>& out)
+        {
+            z_stream zs{};
+            // 16 is added to the window bits to get the gzip wrapper instead of zlib
+            if (deflateInit2(&zs, level > 0 ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Cannot initialize gzip compression");
+            }
+            out.resize(deflateBound(&zs, static_cast<uLong>(size)));
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            zs.avail_in = static_cast<uInt>(size);
+            zs.next_out = reinterpret_cast<Bytef*>(out.data());
+            zs.avail_out = static_cast<uInt>(out.size());
+            const int rc = deflate(&zs, Z_FINISH);
+            out.resize(zs.total_out);
+            deflateEnd(&zs);
+            if (rc != Z_STREAM_END) {
+                throw std::runtime_error("gzip compression failed");
+            }
+        }
+#endif
+
+#ifdef HAVE_ZSTD
+        void compressZstd(int level, const char* data, size_t size, std::vector<char>& out)
+        {
+            // the context keeps its tables between the blocks of one thread
+            thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            out.resize(ZSTD_compressBound(size));
+            const size_t rc = ZSTD_compressCCtx(ctx.get(), out.data(), out.size(), data, size, level > 0 ? level : 3);
+            if (ZSTD_isError(rc)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(rc));
+            }
+            out.resize(rc);
+        }
+#endif
+    }
+
+    Compression parseCompression(const std::string& name)
+    {
+        if (name == "none") {
+            return Compression::NONE;
+        }
+        if (name == "gzip" || name == "gz") {
+            return Compression::GZIP;
+        }
+        if (name == "zstd" || name == "zst") {
+            return Compression::ZSTD;
+        }
+        throw std::invalid_argument("Unknown compression method " + name);
+    }
+
+    bool isCompressionSupported(Compression method)
+    {
+        switch (method) {
+        case Compression::NONE:
+            return true;
+        case Compression::GZIP:
+#ifdef HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case Compression::ZSTD:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    const char* compressionExtension(Compression method)
+    {
+        switch (method) {
+        case Compression::GZIP:
+            return ".gz";
+        case Compression::ZSTD:
+            return ".zst";
+        default:
+            return "";
+        }
+    }
+
+    void compressBlock(Compression method, [[maybe_unused]] int level, const char* data, size_t size, std::vector<char>& out)
+    {
+        switch (method) {
+#ifdef HAVE_ZLIB
+        case Compression::GZIP:
+            compressGzip(level, data, size, out);
+            return;
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::ZSTD:
+            compressZstd(level, data, size, out);
+            return;
+#endif
+        case Compression::NONE:
+            out.assign(data, data + size);
+            return;
+        default:
+            throw std::logic_error("Compression method is not supported by this build");
+        }
+    }
+
+    CompressorPool::CompressorPool(Compression method, int level, size_t blockSize, unsigned threadCount)
+        : m_method(method)
+        , m_level(level)
+        , m_blockSize(blockSize > 0 ? blockSize : DEFAULT_COMPRESS_BLOCK_SIZE)
+    {
+        m_threads.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; i++) {
+            m_threads.emplace_back(&CompressorPool::run, this);
+        }
+    }
+
+    CompressorPool::~CompressorPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        for (auto& th : m_threads) {
+            th.join();
+        }
+    }
+
+    std::future<std::vector<char>> CompressorPool::submit(std::vector<char> block)
+    {
+        std::packaged_task<std::vector<char>()> task(
+            [this, block = std::move(block)]() {
+                std::vector<char> out;
+                compressBlock(m_method, m_level, block.data(), block.size(), out);
+                return out;
+            }
+        );
+        auto result = task.get_future();
+        if (m_threads.empty()) {
+            task();
+            return result;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_cond.notify_one();
+        return result;
+    }
+
+    void CompressorPool::run()
+    {
+        while (true) {
+            std::packaged_task<std::vector<char>()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this] { return m_stopped || !m_tasks.empty(); });
+                if (m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            // an exception is stored in the future
+            task();
+        }
+    }
+
+    CompressSink::CompressSink(OutputSink& target, CompressorPool& pool)
+        : target_(target)
+        , pool_(pool)
+    {
+        block_.reserve(pool_.blockSize());
+    }
+
+    void CompressSink::write(const char* data, size_t size)
+    {
+        const size_t blockSize = pool_.blockSize();
+        while (size > 0) {
+            const size_t n = std::min(size, blockSize - block_.size());
+            block_.insert(block_.end(), data, data + n);
+            data += n;
+            size -= n;
+            if (block_.size() == blockSize) {
+                submitBlock();
+            }
+        }
+    }
+
+    void CompressSink::close()
+    {
+        // empty output is still a valid compressed stream
+        if (!block_.empty() || !submitted_) {
+            submitBlock();
+        }
+        while (!inFlight_.empty()) {
+            writeOldest();
+        }
+    }
+
+    void CompressSink::submitBlock()
+    {
+        if (inFlight_.size() >= pool_.maxInFlight()) {
+            writeOldest();
+        }
+        inFlight_.push_back(pool_.submit(std::move(block_)));
+        submitted_ = true;
+        block_ = std::vector<char>();
+        block_.reserve(pool_.blockSize());
+    }
+
+    void CompressSink::writeOldest()
+    {
+        auto future = std::move(inFlight_.front());
+        inFlight_.pop_front();
+        const auto compressed = future.get();
+        target_.write(compressed.data(), compressed.size());
+    }
+
+} // namespace csv
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef COMPRESS_SINK_H
+#define COMPRESS_SINK_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csv
+{
+    constexpr size_t DEFAULT_COMPRESS_BLOCK_SIZE = MIB;
+
+    enum class Compression { NONE, GZIP, ZSTD };
+
+    // Parses "none", "gzip" or "zstd", throws std::invalid_argument for other names
+    Compression parseCompression(const std::string& name);
+
+    // The library of the method is linked to this build
+    bool isCompressionSupported(Compression method);
+
+    // File name extension of the compressed output, for example ".gz"
+    const char* compressionExtension(Compression method);
+
+    // Compresses a block into a self-contained gzip member or zstd frame.
+    // Such blocks can be concatenated and the result is still a valid stream.
+    void compressBlock(Compression method, int level, const char* data, size_t size, std::vector<char>& out);
+
+    // Worker threads compressing the blocks of all output files
+    class CompressorPool final
+    {
+        const Compression m_method;
+        const int m_level;
+        const size_t m_blockSize;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::deque<std::packaged_task<std::vector<char>()>> m_tasks;
+        bool m_stopped = false;
+    public:
+        // With zero threads the blocks are compressed by the calling thread
+        CompressorPool(Compression method, int level, size_t blockSize, unsigned threadCount);
+
+        ~CompressorPool();
+
+        CompressorPool(const CompressorPool&) = delete;
+        CompressorPool& operator=(const CompressorPool&) = delete;
+
+        Compression method() const
+        {
+            return m_method;
+        }
+
+        size_t blockSize() const
+        {
+            return m_blockSize;
+        }
+
+        // Number of blocks of one sink compressed at the same time
+        size_t maxInFlight() const
+        {
+            return m_threads.size() + 1;
+        }
+
+        std::future<std::vector<char>> submit(std::vector<char> block);
+    private:
+        void run();
+    };
+
+    // Cuts the data into blocks, compresses them in the pool and passes
+    // the compressed blocks to the target sink in the original order.
+    class CompressSink final : public OutputSink
+    {
+        OutputSink& target_;
+        CompressorPool& pool_;
+        std::vector<char> block_;
+        std::deque<std::future<std::vector<char>>> inFlight_;
+        bool submitted_ = false;
+    public:
+        CompressSink(OutputSink& target, CompressorPool& pool);
+
+        void write(const char* data, size_t size) override;
+
+        // Compresses the rest of the data and waits for all blocks.
+        // The target sink is not closed, it belongs to the caller.
+        void close() override;
+    private:
+        void submitBlock();
+
+        void writeOldest();
+    };
+
+} // namespace csv
+
+#endif // COMPRESS_SINK_H
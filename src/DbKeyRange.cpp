@@ -0,0 +1,88 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "DbKeyRange.h"
+
+namespace FBExport
+{
+
+    PageRange PageGeometry::toPageRange(int64_t lower, int64_t upper) const
+    {
+        const int64_t recordsPerPP = dpPerPP * recordsPerDP;
+        PageRange range;
+        range.lowerPP = lower / recordsPerPP;
+        range.lowerDP = lower % recordsPerPP / recordsPerDP;
+        range.upperPP = upper / recordsPerPP;
+        range.upperDP = upper % recordsPerPP / recordsPerDP;
+        return range;
+    }
+
+    SharedRange::SharedRange(int64_t lower, int64_t upper, int64_t recordsPerDP)
+        : m_recordsPerDP(recordsPerDP > 0 ? recordsPerDP : 1)
+        , m_position(lower)
+        , m_upper(upper)
+    {
+    }
+
+    void SharedRange::finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+    }
+
+    int64_t SharedRange::remaining()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_finished ? 0 : m_upper - nextPageStart();
+    }
+
+    bool SharedRange::split(int64_t minRecords, const std::function<void(int64_t lower, int64_t upper)>& onSplit)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finished) {
+            return false;
+        }
+        const int64_t start = nextPageStart();
+        const int64_t size = m_upper - start;
+        if (size < minRecords || size < 2 * m_recordsPerDP) {
+            return false;
+        }
+        // the cut is at a page boundary, like all bounds of the jobs
+        const int64_t middle = start + size / 2 / m_recordsPerDP * m_recordsPerDP;
+        onSplit(middle, m_upper);
+        m_upper = middle;
+        return true;
+    }
+
+    bool SharedRange::enterPage(int64_t recordNumber)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (recordNumber >= m_upper) {
+            return false;
+        }
+        m_pageStart = recordNumber / m_recordsPerDP * m_recordsPerDP;
+        m_pageEnd = m_pageStart + m_recordsPerDP;
+        m_position = m_pageStart;
+        return true;
+    }
+
+} // namespace FBExport
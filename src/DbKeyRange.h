@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef DBKEY_RANGE_H
+#define DBKEY_RANGE_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace FBExport
+{
+    // Records from (lowerPP, lowerDP) up to (upperPP, upperDP) exclusive, where PP is
+    // the sequence number of the pointer page and DP is the data page slot in it
+    struct PageRange
+    {
+        int64_t lowerPP = 0;
+        int64_t lowerDP = 0;
+        int64_t upperPP = 1;
+        int64_t upperDP = 0;
+    };
+
+    // Server constants used to compute the record number of RDB$DB_KEY
+    struct PageGeometry
+    {
+        int64_t dpPerPP = 0;
+        int64_t recordsPerDP = 0;
+
+        bool valid() const
+        {
+            return dpPerPP > 0 && recordsPerDP > 0;
+        }
+
+        int64_t toRecord(int64_t pp, int64_t dp) const
+        {
+            return (pp * dpPerPP + dp) * recordsPerDP;
+        }
+
+        // Both bounds must be at the start of a data page
+        PageRange toPageRange(int64_t lower, int64_t upper) const;
+    };
+
+    // Record number of RDB$DB_KEY value of a little-endian server, other byte orders are
+    // not supported. The key consists of the relation id (2 bytes), the high byte of the
+    // number, a reserved byte and the low 32 bits of the number. The stored number is
+    // the record number + 1. getPageGeometry checks the decoding on a probe key.
+    inline int64_t decodeDbKey(const unsigned char* key)
+    {
+        const uint64_t low = static_cast<uint64_t>(key[4]) 
+            | (static_cast<uint64_t>(key[5]) << 8) 
+            | (static_cast<uint64_t>(key[6]) << 16) 
+            | (static_cast<uint64_t>(key[7]) << 24);
+        return static_cast<int64_t>(((static_cast<uint64_t>(key[2]) << 32) | low) - 1);
+    }
+
+    // Record range of a running job that idle workers can shorten. The owner reports
+    // each fetched record and stops at the first one beyond the current upper bound.
+    // The bound is checked only when the data page changes, so the thieves cut the range
+    // after the page being exported, and the owner can not pass the cut unnoticed.
+    class SharedRange final
+    {
+        std::mutex m_mutex;
+        const int64_t m_recordsPerDP;
+        int64_t m_position;
+        int64_t m_upper;
+        bool m_finished = false;
+        // current data page of the owner, it is accessed only by the owner thread
+        int64_t m_pageStart = 0;
+        int64_t m_pageEnd = 0;
+    public:
+        SharedRange(int64_t lower, int64_t upper, int64_t recordsPerDP);
+
+        SharedRange(const SharedRange&) = delete;
+        SharedRange& operator=(const SharedRange&) = delete;
+
+        // Owner side: false means the record belongs to another job and the export must stop
+        bool accept(int64_t recordNumber)
+        {
+            if (recordNumber >= m_pageStart && recordNumber < m_pageEnd) {
+                return true;
+            }
+            return enterPage(recordNumber);
+        }
+
+        // Owner side: the range can not be split anymore
+        void finish();
+
+        // Records not exported yet, an estimate for choosing the victim
+        int64_t remaining();
+
+        // Thief side: cuts the second half of the unscanned range if it has at least
+        // minRecords records. The callback gets the new range under the lock, so the
+        // owner can not finish in between; if it throws, the range is not changed.
+        bool split(int64_t minRecords, const std::function<void(int64_t lower, int64_t upper)>& onSplit);
+    private:
+        bool enterPage(int64_t recordNumber);
+
+        int64_t nextPageStart() const
+        {
+            return (m_position / m_recordsPerDP + 1) * m_recordsPerDP;
+        }
+    };
+
+} // namespace FBExport
+
+#endif // DBKEY_RANGE_H
@@ -0,0 +1,341 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "DecimalFormat.h"
+#include <charconv>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define DECIMAL_FORMAT_BIG_ENDIAN
+#endif
+
+namespace
+{
+    // Decimal value of every 10-bit DPD declet
+    struct DecletTable
+    {
+        unsigned short values[1024];
+
+        constexpr DecletTable()
+            : values()
+        {
+            for (unsigned d = 0; d < 1024; d++) {
+                values[d] = decode(d);
+            }
+        }
+
+        static constexpr unsigned short decode(unsigned d)
+        {
+            auto bit = [d](unsigned n) { return (d >> n) & 1; };
+            const unsigned b987 = (d >> 7) & 7;
+            const unsigned b654 = (d >> 4) & 7;
+            const unsigned b98 = (d >> 8) & 3;
+            const unsigned b65 = (d >> 5) & 3;
+            const unsigned b210 = d & 7;
+            unsigned d2 = 0, d1 = 0, d0 = 0;
+            if (!bit(3)) {
+                d2 = b987; d1 = b654; d0 = b210;
+            }
+            else {
+                switch ((d >> 1) & 3) {
+                case 0:
+                    d2 = b987; d1 = b654; d0 = 8 + bit(0);
+                    break;
+                case 1:
+                    d2 = b987; d1 = 8 + bit(4); d0 = (b65 << 1) | bit(0);
+                    break;
+                case 2:
+                    d2 = 8 + bit(7); d1 = b654; d0 = (b98 << 1) | bit(0);
+                    break;
+                default:
+                    switch (b65) {
+                    case 0:
+                        d2 = 8 + bit(7); d1 = 8 + bit(4); d0 = (b98 << 1) | bit(0);
+                        break;
+                    case 1:
+                        d2 = 8 + bit(7); d1 = (b98 << 1) | bit(4); d0 = 8 + bit(0);
+                        break;
+                    case 2:
+                        d2 = b987; d1 = 8 + bit(4); d0 = 8 + bit(0);
+                        break;
+                    default:
+                        d2 = 8 + bit(7); d1 = 8 + bit(4); d0 = 8 + bit(0);
+                        break;
+                    }
+                }
+            }
+            return static_cast<unsigned short>(d2 * 100 + d1 * 10 + d0);
+        }
+    };
+
+    constexpr DecletTable DECLETS;
+
+    // Unpacked decimal floating point value
+    struct DecimalValue
+    {
+        bool negative = false;
+        bool infinity = false;
+        bool nan = false;
+        bool signaling = false;
+        int exponent = 0;
+        // coefficient digits, most significant first, without leading zeros
+        char digits[36] = {};
+        unsigned digitCount = 0;
+    };
+
+    void appendDeclet(char*& out, unsigned declet)
+    {
+        const unsigned value = DECLETS.values[declet & 0x3FF];
+        *out++ = static_cast<char>('0' + value / 100);
+        *out++ = static_cast<char>('0' + value / 10 % 10);
+        *out++ = static_cast<char>('0' + value % 10);
+    }
+
+    void stripLeadingZeros(DecimalValue& dec, const char* digits, unsigned count)
+    {
+        unsigned start = 0;
+        while (start + 1 < count && digits[start] == '0') {
+            start++;
+        }
+        dec.digitCount = count - start;
+        std::memcpy(dec.digits, digits + start, dec.digitCount);
+    }
+
+    // IEEE 754 decimal layout: sign (1 bit), combination field (5 bits),
+    // exponent continuation (econBits), coefficient continuation (declets * 10 bits).
+    // hi holds the upper 64 bits, lo the remaining ones (for decimal128).
+    template <unsigned econBits, unsigned declets, int bias>
+    DecimalValue unpackDecimal(uint64_t hi, uint64_t lo)
+    {
+        DecimalValue dec;
+        dec.negative = (hi >> 63) != 0;
+        const unsigned comb = static_cast<unsigned>(hi >> 58) & 0x1F;
+        if ((comb & 0x1E) == 0x1E) {
+            if (comb == 0x1E) {
+                dec.infinity = true;
+                return dec;
+            }
+            dec.nan = true;
+            dec.signaling = ((hi >> 57) & 1) != 0;
+        }
+
+        unsigned msd;
+        unsigned expHigh;
+        if ((comb & 0x18) == 0x18) {
+            expHigh = (comb >> 1) & 3;
+            msd = 8 + (comb & 1);
+        }
+        else {
+            expHigh = comb >> 3;
+            msd = comb & 7;
+        }
+        const unsigned econ = static_cast<unsigned>(hi >> (58 - econBits)) & ((1u << econBits) - 1);
+        dec.exponent = static_cast<int>((expHigh << econBits) | econ) - bias;
+
+        char digits[1 + declets * 3];
+        char* p = digits;
+        // the NaN payload does not use the most significant digit
+        *p++ = static_cast<char>('0' + (dec.nan ? 0 : msd));
+        // coefficient continuation occupies the lower (declets * 10) bits of the value
+        for (int i = static_cast<int>(declets) - 1; i >= 0; i--) {
+            const unsigned shift = static_cast<unsigned>(i) * 10;
+            uint64_t declet;
+            if (shift >= 64) {
+                declet = hi >> (shift - 64);
+            }
+            else if (shift + 10 > 64) {
+                declet = (lo >> shift) | (hi << (64 - shift));
+            }
+            else {
+                declet = lo >> shift;
+            }
+            appendDeclet(p, static_cast<unsigned>(declet));
+        }
+        stripLeadingZeros(dec, digits, static_cast<unsigned>(p - digits));
+        return dec;
+    }
+
+    // to-scientific-string from the General Decimal Arithmetic specification
+    char* writeDecimal(char* out, const DecimalValue& dec)
+    {
+        if (dec.negative) {
+            *out++ = '-';
+        }
+        if (dec.infinity) {
+            std::memcpy(out, "Infinity", 8);
+            return out + 8;
+        }
+        if (dec.nan) {
+            if (dec.signaling) {
+                *out++ = 's';
+            }
+            std::memcpy(out, "NaN", 3);
+            out += 3;
+            if (dec.digitCount > 1 || dec.digits[0] != '0') {
+                std::memcpy(out, dec.digits, dec.digitCount);
+                out += dec.digitCount;
+            }
+            return out;
+        }
+
+        const int count = static_cast<int>(dec.digitCount);
+        const int adjusted = dec.exponent + count - 1;
+        if (dec.exponent <= 0 && adjusted >= -6) {
+            if (dec.exponent == 0) {
+                std::memcpy(out, dec.digits, dec.digitCount);
+                return out + dec.digitCount;
+            }
+            const int pointPos = count + dec.exponent;
+            if (pointPos > 0) {
+                std::memcpy(out, dec.digits, static_cast<size_t>(pointPos));
+                out += pointPos;
+                *out++ = '.';
+                std::memcpy(out, dec.digits + pointPos, static_cast<size_t>(count - pointPos));
+                return out + (count - pointPos);
+            }
+            *out++ = '0';
+            *out++ = '.';
+            std::memset(out, '0', static_cast<size_t>(-pointPos));
+            out += -pointPos;
+            std::memcpy(out, dec.digits, dec.digitCount);
+            return out + dec.digitCount;
+        }
+
+        *out++ = dec.digits[0];
+        if (count > 1) {
+            *out++ = '.';
+            std::memcpy(out, dec.digits + 1, dec.digitCount - 1);
+            out += count - 1;
+        }
+        *out++ = 'E';
+        *out++ = adjusted < 0 ? '-' : '+';
+        return std::to_chars(out, out + 8, adjusted < 0 ? -adjusted : adjusted).ptr;
+    }
+
+    // Divides the 128-bit value by 10^9 in place and returns the remainder
+    uint32_t divmod1e9(uint64_t& hi, uint64_t& lo)
+    {
+        constexpr uint64_t divisor = 1000000000;
+        uint32_t limbs[4] = {
+            static_cast<uint32_t>(hi >> 32), static_cast<uint32_t>(hi),
+            static_cast<uint32_t>(lo >> 32), static_cast<uint32_t>(lo)
+        };
+        uint64_t rem = 0;
+        for (auto& limb : limbs) {
+            const uint64_t cur = (rem << 32) | limb;
+            limb = static_cast<uint32_t>(cur / divisor);
+            rem = cur % divisor;
+        }
+        hi = (static_cast<uint64_t>(limbs[0]) << 32) | limbs[1];
+        lo = (static_cast<uint64_t>(limbs[2]) << 32) | limbs[3];
+        return static_cast<uint32_t>(rem);
+    }
+} // namespace
+
+namespace FBExport
+{
+
+    char* formatScaledInt128(char* out, const FB_I128_t& value, int scale)
+    {
+#ifdef DECIMAL_FORMAT_BIG_ENDIAN
+        uint64_t hi = value.fb_data[0];
+        uint64_t lo = value.fb_data[1];
+#else
+        uint64_t hi = value.fb_data[1];
+        uint64_t lo = value.fb_data[0];
+#endif
+        const bool negative = (hi >> 63) != 0;
+        if (negative) {
+            // two's complement magnitude
+            hi = ~hi;
+            lo = ~lo + 1;
+            if (lo == 0) {
+                hi++;
+            }
+        }
+
+        // digits are produced from the right
+        char digits[40];
+        char* const end = digits + sizeof(digits);
+        char* p = end;
+        while (hi != 0) {
+            uint32_t chunk = divmod1e9(hi, lo);
+            for (int i = 0; i < 9; i++) {
+                *--p = static_cast<char>('0' + chunk % 10);
+                chunk /= 10;
+            }
+        }
+        // the rest fits into 64 bits, which is the usual case
+        do {
+            *--p = static_cast<char>('0' + lo % 10);
+            lo /= 10;
+        } while (lo != 0);
+        while (p + 1 < end && *p == '0') {
+            p++;
+        }
+        const auto count = static_cast<size_t>(end - p);
+
+        if (negative) {
+            *out++ = '-';
+        }
+        if (scale >= 0) {
+            std::memcpy(out, p, count);
+            out += count;
+            if (scale > 0 && !(count == 1 && *p == '0')) {
+                std::memset(out, '0', static_cast<size_t>(scale));
+                out += scale;
+            }
+            return out;
+        }
+
+        const auto fracDigits = static_cast<size_t>(-scale);
+        if (count > fracDigits) {
+            const size_t intDigits = count - fracDigits;
+            std::memcpy(out, p, intDigits);
+            out += intDigits;
+            *out++ = '.';
+            std::memcpy(out, p + intDigits, fracDigits);
+            return out + fracDigits;
+        }
+        *out++ = '0';
+        *out++ = '.';
+        std::memset(out, '0', fracDigits - count);
+        out += fracDigits - count;
+        std::memcpy(out, p, count);
+        return out + count;
+    }
+
+    char* formatDecFloat16(char* out, const FB_DEC16_t& value)
+    {
+        return writeDecimal(out, unpackDecimal<8, 5, 398>(value.fb_data[0], value.fb_data[0]));
+    }
+
+    char* formatDecFloat34(char* out, const FB_DEC34_t& value)
+    {
+#ifdef DECIMAL_FORMAT_BIG_ENDIAN
+        return writeDecimal(out, unpackDecimal<12, 11, 6176>(value.fb_data[0], value.fb_data[1]));
+#else
+        return writeDecimal(out, unpackDecimal<12, 11, 6176>(value.fb_data[1], value.fb_data[0]));
+#endif
+    }
+
+} // namespace FBExport
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef DECIMAL_FORMAT_H
+#define DECIMAL_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <firebird/Interface.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace FBExport
+{
+    // Sign, 39 digits, decimal point and leading zeros for the scale up to -38
+    inline constexpr size_t MAX_SCALED_INT128_LENGTH = 44;
+    // Same as the IDecFloatXX::STRING_SIZE
+    inline constexpr size_t MAX_DECFLOAT16_LENGTH = 24;
+    inline constexpr size_t MAX_DECFLOAT34_LENGTH = 43;
+
+    // Writes INT128 value (NUMERIC/DECIMAL with precision above 18) with the given scale.
+    // Returns the pointer past the last written character.
+    char* formatScaledInt128(char* out, const FB_I128_t& value, int scale);
+
+    // DECFLOAT(16) and DECFLOAT(34) are stored by Firebird in the IEEE 754 decimal 
+    // interchange format with the DPD (densely packed decimal) coefficient encoding.
+    // The values are written in the same way as IDecFloatXX::toString does:
+    // plain notation when the exponent allows it, scientific otherwise.
+    // Returns the pointer past the last written character.
+    char* formatDecFloat16(char* out, const FB_DEC16_t& value);
+
+    char* formatDecFloat34(char* out, const FB_DEC34_t& value);
+
+} // namespace FBExport
+
+#endif // DECIMAL_FORMAT_H
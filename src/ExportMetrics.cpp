@@ -0,0 +1,319 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "ExportMetrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace FBExport
+{
+    namespace
+    {
+        int64_t toMicroseconds(std::chrono::nanoseconds value)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(value).count();
+        }
+
+        std::string jsonString(const std::string& value)
+        {
+            std::string ret;
+            ret.reserve(value.size() + 2);
+            ret += '"';
+            for (const char c : value) {
+                switch (c) {
+                case '"':
+                    ret += "\\\"";
+                    break;
+                case '\\':
+                    ret += "\\\\";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char code[8];
+                        std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                        ret += code;
+                    }
+                    else {
+                        ret += c;
+                    }
+                }
+            }
+            ret += '"';
+            return ret;
+        }
+
+        // The timers shared by the jobs, the workers and the whole run
+        void writeTimes(std::ostream& out, const JobMetrics& metrics)
+        {
+            out << "\"prepare_us\": " << toMicroseconds(metrics.prepareTime)
+                << ", \"fetch_us\": " << toMicroseconds(metrics.fetchTime)
+                << ", \"format_us\": " << toMicroseconds(metrics.formatTime)
+                << ", \"write_us\": " << toMicroseconds(metrics.writeTime)
+                << ", \"merge_wait_us\": " << toMicroseconds(metrics.mergeWaitTime)
+                << ", \"merge_us\": " << toMicroseconds(metrics.mergeTime);
+        }
+
+        void addTimes(JobMetrics& total, const JobMetrics& job)
+        {
+            total.rows += job.rows;
+            total.bytes += job.bytes;
+            total.totalTime += job.totalTime;
+            total.prepareTime += job.prepareTime;
+            total.fetchTime += job.fetchTime;
+            total.formatTime += job.formatTime;
+            total.writeTime += job.writeTime;
+            total.mergeWaitTime += job.mergeWaitTime;
+            total.mergeTime += job.mergeTime;
+        }
+
+        // Microseconds with the fraction, the unit of the trace timestamps
+        std::string traceTime(std::chrono::nanoseconds value)
+        {
+            const int64_t ns = value.count();
+            char text[32];
+            std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+            return text;
+        }
+
+        std::string formatRate(double value, const char* unit)
+        {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1) << value << ' ' << unit;
+            return out.str();
+        }
+    }
+
+    ExportMetrics::ExportMetrics()
+        : m_start(MetricsClock::now())
+    {
+    }
+
+    ExportMetrics::~ExportMetrics()
+    {
+        stopProgress();
+    }
+
+    void ExportMetrics::addJob(const JobMetrics& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(job);
+        }
+        m_progress.jobs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ExportMetrics::addSpan(const char* name, unsigned worker, std::chrono::nanoseconds startTime)
+    {
+        if (!m_tracing) {
+            return;
+        }
+        TraceSpan span;
+        span.name = name;
+        span.worker = worker;
+        span.startTime = startTime;
+        span.duration = elapsed() - startTime;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_spans.push_back(std::move(span));
+    }
+
+    void ExportMetrics::startProgress(std::chrono::seconds interval, uint64_t expectedBytes)
+    {
+        m_showProgress = true;
+        m_progressThread = std::thread(&ExportMetrics::progressLoop, this, interval, expectedBytes);
+    }
+
+    void ExportMetrics::stopProgress()
+    {
+        if (!m_progressThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_stopCond.notify_all();
+        m_progressThread.join();
+    }
+
+    void ExportMetrics::progressLoop(std::chrono::seconds interval, uint64_t expectedBytes)
+    {
+        uint64_t lastRows = 0;
+        uint64_t lastBytes = 0;
+        auto lastTime = MetricsClock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopCond.wait_for(lock, interval, [this] { return m_stopped; })) {
+            const auto now = MetricsClock::now();
+            const uint64_t rows = m_progress.rows.load(std::memory_order_relaxed);
+            const uint64_t bytes = m_progress.bytes.load(std::memory_order_relaxed);
+            const uint64_t jobs = m_progress.jobs.load(std::memory_order_relaxed);
+            const double seconds = std::chrono::duration<double>(now - lastTime).count();
+            const double total = std::chrono::duration<double>(now - m_start).count();
+
+            // the rates are of the last interval, the ETA uses the average rate of the run
+            std::ostringstream line;
+            line << "Progress: " << std::fixed << std::setprecision(0) << total << " s"
+                << ", jobs done: " << jobs
+                << ", rows: " << rows << " (" << formatRate((rows - lastRows) / seconds, "rows/s") << ")"
+                << ", " << formatRate(bytes / double(csv::MIB), "MiB")
+                << " (" << formatRate((bytes - lastBytes) / seconds / csv::MIB, "MiB/s") << ")";
+            if (expectedBytes > 0 && bytes > 0) {
+                const double left = expectedBytes > bytes ? (expectedBytes - bytes) * total / bytes : 0.0;
+                line << ", ETA: " << std::setprecision(0) << left << " s";
+            }
+            std::cout << line.str() << std::endl;
+
+            lastRows = rows;
+            lastBytes = bytes;
+            lastTime = now;
+        }
+    }
+
+    std::map<std::string, uint64_t> ExportMetrics::tableBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::string, uint64_t> ret;
+        for (const auto& job : m_jobs) {
+            ret[job.table] += job.bytes;
+        }
+        return ret;
+    }
+
+    bool ExportMetrics::writeReport(
+        const fs::path& path,
+        unsigned threads,
+        const csv::WriteStats& writeStats,
+        const BlobStats& blobStats) const
+    {
+        std::vector<JobMetrics> jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            jobs = m_jobs;
+        }
+        std::stable_sort(jobs.begin(), jobs.end(), [](const JobMetrics& a, const JobMetrics& b) {
+            return a.startTime < b.startTime;
+        });
+
+        JobMetrics total;
+        std::vector<JobMetrics> workers(threads);
+        std::vector<uint64_t> workerJobs(threads);
+        for (const auto& job : jobs) {
+            addTimes(total, job);
+            if (job.worker < threads) {
+                addTimes(workers[job.worker], job);
+                workerJobs[job.worker]++;
+            }
+        }
+
+        std::ofstream out(path, std::ios::trunc);
+        out << "{\n"
+            << "  \"elapsed_us\": " << toMicroseconds(elapsed()) << ",\n"
+            << "  \"threads\": " << threads << ",\n"
+            << "  \"timed\": " << (m_timed ? "true" : "false") << ",\n"
+            << "  \"rows\": " << total.rows << ",\n"
+            << "  \"bytes\": " << total.bytes << ",\n"
+            << "  \"bytes_written\": " << writeStats.bytes << ",\n"
+            << "  \"write_calls\": " << writeStats.syscalls << ",\n"
+            << "  \"blobs\": { \"count\": " << blobStats.count
+            << ", \"streamed\": " << blobStats.streamed
+            << ", \"bytes\": " << blobStats.bytes
+            << ", \"open_us\": " << toMicroseconds(blobStats.openTime) << " },\n"
+            << "  \"totals\": { ";
+        writeTimes(out, total);
+        out << " },\n"
+            << "  \"workers\": [";
+        for (unsigned i = 0; i < threads; i++) {
+            const auto& worker = workers[i];
+            out << (i > 0 ? "," : "") << "\n    { \"worker\": " << i
+                << ", \"jobs\": " << workerJobs[i]
+                << ", \"rows\": " << worker.rows
+                << ", \"bytes\": " << worker.bytes
+                << ", \"busy_us\": " << toMicroseconds(worker.totalTime) << ", ";
+            writeTimes(out, worker);
+            out << " }";
+        }
+        out << "\n  ],\n"
+            << "  \"jobs\": [";
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const auto& job = jobs[i];
+            out << (i > 0 ? "," : "") << "\n    { \"table\": " << jsonString(job.table)
+                << ", \"page_sequence\": " << job.pageSequence
+                << ", \"part\": " << job.part
+                << ", \"stolen\": " << (job.stolen ? "true" : "false")
+                << ", \"worker\": " << job.worker
+                << ", \"rows\": " << job.rows
+                << ", \"bytes\": " << job.bytes
+                << ", \"start_us\": " << toMicroseconds(job.startTime)
+                << ", \"elapsed_us\": " << toMicroseconds(job.totalTime) << ", ";
+            writeTimes(out, job);
+            out << " }";
+        }
+        out << "\n  ]\n"
+            << "}\n";
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    bool ExportMetrics::writeTrace(const fs::path& path, unsigned threads) const
+    {
+        std::vector<JobMetrics> jobs;
+        std::vector<TraceSpan> spans;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            jobs = m_jobs;
+            spans = m_spans;
+        }
+
+        std::ofstream out(path, std::ios::trunc);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for (unsigned i = 0; i < threads; i++) {
+            const std::string name = i == 0 ? "main" : "worker " + std::to_string(i);
+            out << (i > 0 ? "," : "") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i
+                << ", \"args\": {\"name\": " << jsonString(name) << "}}";
+        }
+        for (const auto& job : jobs) {
+            out << ",\n{\"name\": " << jsonString(job.table + (job.stolen ? " (stolen)" : ""))
+                << ", \"cat\": \"job\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << job.worker
+                << ", \"ts\": " << traceTime(job.startTime)
+                << ", \"dur\": " << traceTime(job.totalTime)
+                << ", \"args\": {\"table\": " << jsonString(job.table)
+                << ", \"page_sequence\": " << job.pageSequence
+                << ", \"part\": " << job.part
+                << ", \"worker\": " << job.worker
+                << ", \"rows\": " << job.rows
+                << ", \"bytes\": " << job.bytes << "}}";
+        }
+        for (const auto& span : spans) {
+            out << ",\n{\"name\": " << jsonString(span.name)
+                << ", \"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << span.worker
+                << ", \"ts\": " << traceTime(span.startTime)
+                << ", \"dur\": " << traceTime(span.duration) << "}";
+        }
+        out << "\n]}\n";
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+} // namespace FBExport
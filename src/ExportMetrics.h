@@ -0,0 +1,277 @@
+#pragma once
+
+#ifndef EXPORT_METRICS_H
+#define EXPORT_METRICS_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include "BlobFormat.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace FBExport
+{
+    using MetricsClock = std::chrono::steady_clock;
+
+    // The rows are added to the progress totals in batches of this size
+    inline constexpr uint64_t PROGRESS_ROW_BATCH = 1024;
+
+    // Totals of the running export, updated by the export threads and read by the progress thread
+    struct ExportProgress
+    {
+        std::atomic<uint64_t> rows{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> jobs{ 0 };
+    };
+
+    // Counters of one export job. The bytes are the CSV text passed to the output
+    // before compression. The fetch, format and write times are measured only for
+    // the report; the format time of the pipeline is the sum of all formatter threads.
+    // The write time includes the compression and the wait for the merger.
+    struct JobMetrics
+    {
+        std::string table;
+        int32_t pageSequence = 0;
+        size_t part = 0;
+        bool stolen = false;
+        // 0 is the main thread
+        unsigned worker = 0;
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+        // since the start of the export
+        std::chrono::nanoseconds startTime{ 0 };
+        std::chrono::nanoseconds totalTime{ 0 };
+        std::chrono::nanoseconds prepareTime{ 0 };
+        std::chrono::nanoseconds fetchTime{ 0 };
+        std::chrono::nanoseconds formatTime{ 0 };
+        std::chrono::nanoseconds writeTime{ 0 };
+        std::chrono::nanoseconds mergeWaitTime{ 0 };
+        // the head part writing the finished parts after it to the file
+        std::chrono::nanoseconds mergeTime{ 0 };
+    };
+
+    // Phase of a thread on the timeline trace, the jobs are added from their metrics
+    struct TraceSpan
+    {
+        std::string name;
+        unsigned worker = 0;
+        // since the start of the export
+        std::chrono::nanoseconds startTime{ 0 };
+        std::chrono::nanoseconds duration{ 0 };
+    };
+
+    // Counts the rows of one cursor and, if the job is timed, splits the time of the
+    // fetching thread between fetchNext and the formatting. The clock is read twice
+    // per row, so the timing is enabled only when the report is requested.
+    class RowMeter final
+    {
+        JobMetrics* m_job;
+        std::atomic<uint64_t>* m_progress;
+        const bool m_timed;
+        MetricsClock::time_point m_mark;
+        uint64_t m_rows = 0;
+        uint64_t m_published = 0;
+    public:
+        RowMeter(JobMetrics* job, std::atomic<uint64_t>* progress, bool timed)
+            : m_job(job)
+            , m_progress(progress)
+            , m_timed(timed && job)
+        {
+            restart();
+        }
+
+        RowMeter(const RowMeter&) = delete;
+        RowMeter& operator=(const RowMeter&) = delete;
+
+        ~RowMeter()
+        {
+            publish();
+            if (m_job) {
+                m_job->rows += m_rows;
+            }
+        }
+
+        bool timed() const
+        {
+            return m_timed;
+        }
+
+        // The time since the last mark belongs to no stage
+        void restart()
+        {
+            if (m_timed) {
+                m_mark = MetricsClock::now();
+            }
+        }
+
+        void fetched()
+        {
+            if (m_timed) {
+                m_job->fetchTime += lap();
+            }
+        }
+
+        void formatted()
+        {
+            if (m_timed) {
+                m_job->formatTime += lap();
+            }
+        }
+
+        // Formatting done by other threads
+        void addFormatTime(std::chrono::nanoseconds time)
+        {
+            if (m_timed) {
+                m_job->formatTime += time;
+            }
+        }
+
+        void row()
+        {
+            if (++m_rows - m_published == PROGRESS_ROW_BATCH) {
+                publish();
+            }
+        }
+    private:
+        std::chrono::nanoseconds lap()
+        {
+            const auto now = MetricsClock::now();
+            const auto ret = now - m_mark;
+            m_mark = now;
+            return ret;
+        }
+
+        void publish()
+        {
+            if (m_progress) {
+                m_progress->fetch_add(m_rows - m_published, std::memory_order_relaxed);
+            }
+            m_published = m_rows;
+        }
+    };
+
+    // Counters of the whole run. Collects the metrics of the finished jobs,
+    // prints the progress lines, writes the JSON report and the timeline trace.
+    class ExportMetrics final
+    {
+        const MetricsClock::time_point m_start;
+        bool m_timed = false;
+        bool m_tracing = false;
+        bool m_showProgress = false;
+        ExportProgress m_progress;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_stopCond;
+        std::vector<JobMetrics> m_jobs;
+        std::vector<TraceSpan> m_spans;
+        std::thread m_progressThread;
+        bool m_stopped = false;
+    public:
+        ExportMetrics();
+
+        ExportMetrics(const ExportMetrics&) = delete;
+        ExportMetrics& operator=(const ExportMetrics&) = delete;
+
+        ~ExportMetrics();
+
+        // Measure the fetch, format and write times of every row
+        void setTimed(bool timed)
+        {
+            m_timed = timed;
+        }
+
+        bool timed() const
+        {
+            return m_timed;
+        }
+
+        // Record the phases of the threads for the timeline trace
+        void setTracing(bool tracing)
+        {
+            m_tracing = tracing;
+        }
+
+        bool tracing() const
+        {
+            return m_tracing;
+        }
+
+        // The progress totals, nullptr if the progress is not shown
+        std::atomic<uint64_t>* progressRows()
+        {
+            return m_showProgress ? &m_progress.rows : nullptr;
+        }
+
+        std::atomic<uint64_t>* progressBytes()
+        {
+            return m_showProgress ? &m_progress.bytes : nullptr;
+        }
+
+        std::chrono::nanoseconds elapsed() const
+        {
+            return MetricsClock::now() - m_start;
+        }
+
+        // Thread safe
+        void addJob(const JobMetrics& job);
+
+        // Adds the phase that started at the given time and ends now, if the trace is recorded.
+        // Thread safe.
+        void addSpan(const char* name, unsigned worker, std::chrono::nanoseconds startTime);
+
+        // Prints a progress line every interval until stopProgress() is called.
+        // The ETA is shown when the expected size of the output is known.
+        void startProgress(std::chrono::seconds interval, uint64_t expectedBytes);
+
+        void stopProgress();
+
+        // CSV bytes of each table, valid when all jobs are finished
+        std::map<std::string, uint64_t> tableBytes() const;
+
+        // Returns false if the file can not be written
+        bool writeReport(
+            const fs::path& path,
+            unsigned threads,
+            const csv::WriteStats& writeStats,
+            const BlobStats& blobStats) const;
+
+        // Writes the jobs and the phases in the Chrome trace event format, one track
+        // per thread. Returns false if the file can not be written.
+        bool writeTrace(const fs::path& path, unsigned threads) const;
+    private:
+        void progressLoop(std::chrono::seconds interval, uint64_t expectedBytes);
+    };
+
+} // namespace FBExport
+
+#endif // EXPORT_METRICS_H
@@ -0,0 +1,382 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "FormatPlan.h"
+#include "NumericFormat.h"
+#include "DecimalFormat.h"
+#include "HexFormat.h"
+#include <cstdarg>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	using FBExport::FormatContext;
+	using FBExport::ColumnFormat;
+
+	constexpr char WHITESPACE[] = " \n\r\t\f\v";
+
+	size_t rtrimLength(const char* s, size_t length)
+	{
+		while (length > 0 && s[length - 1] != '\0' && std::strchr(WHITESPACE, s[length - 1])) {
+			length--;
+		}
+		return length;
+	}
+
+	std::string vformat(const char* zcFormat, ...)
+	{
+
+		// initialize use of the variable argument array
+		va_list vaArgs;
+		va_start(vaArgs, zcFormat);
+
+		// reliably acquire the size
+		// from a copy of the variable argument array
+		// and a functionally reliable call to mock the formatting
+		va_list vaArgsCopy;
+		va_copy(vaArgsCopy, vaArgs);
+		const int iLen = std::vsnprintf(nullptr, 0, zcFormat, vaArgsCopy);
+		va_end(vaArgsCopy);
+
+		// return a formatted string without risking memory mismanagement
+		// and without assuming any compiler or platform specific behavior
+		std::vector<char> zc(iLen + 1);
+		std::vsnprintf(zc.data(), zc.size(), zcFormat, vaArgs);
+		va_end(vaArgs);
+		return std::string(zc.data(), iLen);
+	}
+
+	template <typename T>
+	T readValue(const unsigned char* value)
+	{
+		return *reinterpret_cast<const T*>(value);
+	}
+
+	// Column formatters. Each one handles a single type, the type dispatch
+	// is done once in FormatPlan::compile.
+
+	void formatNull(FormatContext&, const ColumnFormat&, const unsigned char*, csv::CSVFile& csv)
+	{
+		// can not support export array data
+		csv << nullptr;
+	}
+
+	void writeBlob(FormatContext& ctx, const unsigned char* value, bool text, csv::CSVFile& csv)
+	{
+		if (!ctx.blobs) {
+			throw std::logic_error("BLOB values can not be read without the connection");
+		}
+		ctx.blobs->write(ctx.status, ctx.att, ctx.tra, readValue<ISC_QUAD>(value), text, ctx.options.blobEncoding, csv);
+	}
+
+	void formatTextBlob(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// BLOB SUB_TYPE TEXT
+		writeBlob(ctx, value, true, csv);
+	}
+
+	void formatBinaryBlob(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// BLOB SUB_TYPE BINARY and the others
+		writeBlob(ctx, value, false, csv);
+	}
+
+	void formatBoolean(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		csv.write(readValue<unsigned char>(value) ? "1" : "0");
+	}
+
+	void formatGuid(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// special case BINARY(16) as GUID
+		auto guid = reinterpret_cast<const Firebird::Guid*>(value);
+		char* out = csv.reserveField(FBExport::GUID_STRING_LENGTH);
+		csv.commitField(FBExport::formatGuid(out, *guid));
+	}
+
+	void writeHex(const unsigned char* data, size_t length, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(length * 2);
+		csv.commitField(FBExport::encodeHex(out, data, length));
+	}
+
+	void formatBinary(FormatContext&, const ColumnFormat& column, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// BINARY(N)
+		writeHex(value, column.length, csv);
+	}
+
+	void formatChar(FormatContext&, const ColumnFormat& column, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// CHAR(N)
+		auto s = reinterpret_cast<const char*>(value);
+		csv.writeString(s, rtrimLength(s, column.length));
+	}
+
+	void formatVarBinary(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// VARBINARY(N)
+		auto len = readValue<unsigned short>(value);
+		writeHex(value + 2, len, csv);
+	}
+
+	void formatVarChar(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		// VARCHAR(N)
+		auto len = readValue<unsigned short>(value);
+		csv.writeString(reinterpret_cast<const char*>(value + 2), len);
+	}
+
+	template <typename T>
+	void formatInteger(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		csv << readValue<T>(value);
+	}
+
+	template <typename T>
+	void formatScaledInteger(FormatContext&, const ColumnFormat& column, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_SCALED_INT64_LENGTH);
+		csv.commitField(FBExport::formatScaledInt64(out, readValue<T>(value), column.scale));
+	}
+
+	void formatInt128(FormatContext&, const ColumnFormat& column, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_SCALED_INT128_LENGTH);
+		csv.commitField(FBExport::formatScaledInt128(out, readValue<FB_I128_t>(value), column.scale));
+	}
+
+	template <typename T>
+	void formatFloat(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		const int precision = ctx.options.floatPrecision;
+		char* out = csv.reserveField(FBExport::floatLength(precision));
+		csv.commitField(FBExport::formatFloat(out, readValue<T>(value), precision));
+	}
+
+	void formatDate(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_DATE_LENGTH);
+		csv.commitField(FBExport::formatDate(out, readValue<ISC_DATE>(value)));
+	}
+
+	void formatTime(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_TIME_LENGTH);
+		csv.commitField(FBExport::formatTime(out, readValue<ISC_TIME>(value)));
+	}
+
+	void formatTimestamp(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_TIMESTAMP_LENGTH);
+		csv.commitField(FBExport::formatTimestamp(out, readValue<ISC_TIMESTAMP>(value)));
+	}
+
+	void formatDec16(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_DECFLOAT16_LENGTH);
+		csv.commitField(FBExport::formatDecFloat16(out, readValue<FB_DEC16_t>(value)));
+	}
+
+	void formatDec34(FormatContext&, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		char* out = csv.reserveField(FBExport::MAX_DECFLOAT34_LENGTH);
+		csv.commitField(FBExport::formatDecFloat34(out, readValue<FB_DEC34_t>(value)));
+	}
+
+	// Local time followed by the zone name
+	void writeTimestampTz(FormatContext& ctx, const ISC_TIMESTAMP& utc, unsigned short zoneId, int offsetMinutes, csv::CSVFile& csv)
+	{
+		if (FBExport::isOffsetTimeZone(zoneId)) {
+			char* out = csv.reserveField(FBExport::MAX_TIMESTAMP_LENGTH + 1 + FBExport::MAX_TIME_ZONE_OFFSET_LENGTH);
+			out = FBExport::formatTimestamp(out, FBExport::shiftTimestamp(utc, offsetMinutes));
+			*out++ = ' ';
+			csv.commitField(FBExport::formatTimeZoneOffset(out, offsetMinutes));
+			return;
+		}
+		auto zoneName = ctx.timeZones.get(ctx.status, ctx.util, zoneId);
+		char* out = csv.reserveField(FBExport::MAX_TIMESTAMP_LENGTH + 1 + zoneName.size());
+		out = FBExport::formatTimestamp(out, FBExport::shiftTimestamp(utc, offsetMinutes));
+		*out++ = ' ';
+		zoneName.copy(out, zoneName.size());
+		csv.commitField(out + zoneName.size());
+	}
+
+	void writeTimeTz(FormatContext& ctx, ISC_TIME utc, unsigned short zoneId, int offsetMinutes, csv::CSVFile& csv)
+	{
+		if (FBExport::isOffsetTimeZone(zoneId)) {
+			char* out = csv.reserveField(FBExport::MAX_TIME_LENGTH + 1 + FBExport::MAX_TIME_ZONE_OFFSET_LENGTH);
+			out = FBExport::formatTime(out, FBExport::shiftTime(utc, offsetMinutes));
+			*out++ = ' ';
+			csv.commitField(FBExport::formatTimeZoneOffset(out, offsetMinutes));
+			return;
+		}
+		auto zoneName = ctx.timeZones.get(ctx.status, ctx.util, zoneId);
+		char* out = csv.reserveField(FBExport::MAX_TIME_LENGTH + 1 + zoneName.size());
+		out = FBExport::formatTime(out, FBExport::shiftTime(utc, offsetMinutes));
+		*out++ = ' ';
+		zoneName.copy(out, zoneName.size());
+		csv.commitField(out + zoneName.size());
+	}
+
+	void formatTimestampTz(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		auto tsPtr = reinterpret_cast<const ISC_TIMESTAMP_TZ*>(value);
+		if (FBExport::isOffsetTimeZone(tsPtr->time_zone)) {
+			writeTimestampTz(ctx, tsPtr->utc_timestamp, tsPtr->time_zone, FBExport::offsetTimeZoneMinutes(tsPtr->time_zone), csv);
+			return;
+		}
+		// the offset of a region is unknown without the time zone database
+		unsigned int year, month, day;
+		unsigned int hours, minutes, seconds, fractions;
+		char tsBuffer[32] = { 0 };
+		ctx.util->decodeTimeStampTz(
+			ctx.status, tsPtr,
+			&year, &month, &day,
+			&hours, &minutes, &seconds, &fractions,
+			static_cast<unsigned int>(std::size(tsBuffer)),
+			tsBuffer
+		);
+		auto s = vformat("%d-%02d-%02d %02d:%02d:%02d.%04d %s", year, month, day, hours, minutes, seconds, fractions, tsBuffer);
+		csv.write(s);
+	}
+
+	void formatTimeTz(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		auto tsPtr = reinterpret_cast<const ISC_TIME_TZ*>(value);
+		if (FBExport::isOffsetTimeZone(tsPtr->time_zone)) {
+			writeTimeTz(ctx, tsPtr->utc_time, tsPtr->time_zone, FBExport::offsetTimeZoneMinutes(tsPtr->time_zone), csv);
+			return;
+		}
+		unsigned int hours, minutes, seconds, fractions;
+		char tsBuffer[32] = { 0 };
+		ctx.util->decodeTimeTz(
+			ctx.status, tsPtr,
+			&hours, &minutes, &seconds, &fractions,
+			static_cast<unsigned int>(std::size(tsBuffer)),
+			tsBuffer
+		);
+		auto s = vformat("%02d:%02d:%02d.%04d %s", hours, minutes, seconds, fractions, tsBuffer);
+		csv.write(s);
+	}
+
+	// The _EX types carry the zone offset of the value computed by the server
+	void formatTimestampTzEx(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		auto tsPtr = reinterpret_cast<const ISC_TIMESTAMP_TZ_EX*>(value);
+		writeTimestampTz(ctx, tsPtr->utc_timestamp, tsPtr->time_zone, tsPtr->ext_offset, csv);
+	}
+
+	void formatTimeTzEx(FormatContext& ctx, const ColumnFormat&, const unsigned char* value, csv::CSVFile& csv)
+	{
+		auto tsPtr = reinterpret_cast<const ISC_TIME_TZ_EX*>(value);
+		writeTimeTz(ctx, tsPtr->utc_time, tsPtr->time_zone, tsPtr->ext_offset, csv);
+	}
+
+	template <typename T>
+	FBExport::FormatFunc chooseIntegerFormat(int scale)
+	{
+		return scale == 0 ? formatInteger<T> : formatScaledInteger<T>;
+	}
+
+	FBExport::FormatFunc chooseFormat(const Firebird::SQLDA& field)
+	{
+		switch (field.type) {
+		case SQL_BOOLEAN:
+			return formatBoolean;
+		case SQL_TEXT:
+			if (field.charset == 1) {
+				return field.length == 16 ? formatGuid : formatBinary;
+			}
+			return formatChar;
+		case SQL_VARYING:
+			return field.charset == 1 ? formatVarBinary : formatVarChar;
+		case SQL_SHORT:
+			return chooseIntegerFormat<short>(field.scale);
+		case SQL_LONG:
+			return chooseIntegerFormat<int>(field.scale);
+		case SQL_INT64:
+			return chooseIntegerFormat<int64_t>(field.scale);
+		case SQL_INT128:
+			return formatInt128;
+		case SQL_FLOAT:
+			return formatFloat<float>;
+		case SQL_D_FLOAT:
+		case SQL_DOUBLE:
+			return formatFloat<double>;
+		case SQL_TYPE_DATE:
+			return formatDate;
+		case SQL_TYPE_TIME:
+			return formatTime;
+		case SQL_TIMESTAMP:
+			return formatTimestamp;
+		case SQL_DEC16:
+			return formatDec16;
+		case SQL_DEC34:
+			return formatDec34;
+		case SQL_TIMESTAMP_TZ:
+			return formatTimestampTz;
+		case SQL_TIME_TZ:
+			return formatTimeTz;
+		case SQL_TIMESTAMP_TZ_EX:
+			return formatTimestampTzEx;
+		case SQL_TIME_TZ_EX:
+			return formatTimeTzEx;
+		case SQL_BLOB:
+			return field.sub_type == isc_blob_text ? formatTextBlob : formatBinaryBlob;
+		case SQL_ARRAY:
+		default:
+			return formatNull;
+		}
+	}
+} // namespace
+
+namespace FBExport
+{
+	FormatContext::FormatContext(Firebird::ThrowStatusWrapper* aStatus, Firebird::IMaster* master, const FormatOptions& aOptions)
+		: status(aStatus)
+		, util(master->getUtilInterface())
+		, options(aOptions)
+		, timeZones()
+	{
+	}
+
+	void FormatPlan::compile(const Firebird::SQLDAList& fields)
+	{
+		m_columns.clear();
+		m_columns.reserve(fields.size());
+		m_hasBlobs = false;
+		for (const auto& field : fields) {
+			auto&& column = m_columns.emplace_back();
+			column.format = chooseFormat(field);
+			column.offset = field.offset;
+			column.nullOffset = field.nullOffset;
+			column.length = field.length;
+			column.scale = static_cast<short>(field.scale);
+			column.type = static_cast<unsigned short>(field.type);
+			m_hasBlobs = m_hasBlobs || field.type == SQL_BLOB;
+		}
+	}
+
+} // namespace FBExport
@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef FORMAT_PLAN_H
+#define FORMAT_PLAN_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "CSVFile.h"
+#include "sqlda.h"
+#include "TemporalFormat.h"
+#include "BlobFormat.h"
+#include <firebird/Interface.h>
+#include <vector>
+
+namespace FBExport
+{
+    // User settings of the output format
+    struct FormatOptions
+    {
+        // digits after the point for FLOAT and DOUBLE PRECISION, -1 is the shortest exact form
+        int floatPrecision = -1;
+        // text of binary BLOBs
+        BlobEncoding blobEncoding = BlobEncoding::HEX;
+    };
+
+    // Per-worker state available to the column formatters
+    struct FormatContext
+    {
+        Firebird::ThrowStatusWrapper* status;
+        Firebird::IUtil* util;
+        const FormatOptions& options;
+        TimeZoneNameCache timeZones;
+        // BLOB values are read by the thread that fetches the rows, with its connection
+        Firebird::IAttachment* att = nullptr;
+        Firebird::ITransaction* tra = nullptr;
+        BlobWriter* blobs = nullptr;
+        // BLOB value read whole, for the binary formats that write its length first
+        std::string blob;
+
+        FormatContext(Firebird::ThrowStatusWrapper* aStatus, Firebird::IMaster* master, const FormatOptions& aOptions);
+    };
+
+    struct ColumnFormat;
+
+    using FormatFunc = void (*)(FormatContext& ctx, const ColumnFormat& column, const unsigned char* value, csv::CSVFile& csv);
+
+    // Compact description of one output column. The formatter is chosen 
+    // once for the column type, so the row loop does not look at the type at all.
+    struct ColumnFormat
+    {
+        FormatFunc format = nullptr;
+        unsigned offset = 0;
+        unsigned nullOffset = 0;
+        unsigned length = 0;
+        short scale = 0;
+        unsigned short type = 0;
+    };
+
+    class FormatPlan
+    {
+        std::vector<ColumnFormat> m_columns;
+        bool m_hasBlobs = false;
+    public:
+        void compile(const Firebird::SQLDAList& fields);
+
+        void clear()
+        {
+            m_columns.clear();
+            m_hasBlobs = false;
+        }
+
+        // The BLOB columns need FormatContext with the connection
+        bool hasBlobs() const
+        {
+            return m_hasBlobs;
+        }
+
+        size_t size() const
+        {
+            return m_columns.size();
+        }
+
+        void formatRow(FormatContext& ctx, const unsigned char* buffer, csv::CSVFile& csv) const
+        {
+            for (const auto& column : m_columns) {
+                if (*reinterpret_cast<const short*>(buffer + column.nullOffset)) {
+                    csv << nullptr;
+                    continue;
+                }
+                column.format(ctx, column, buffer + column.offset, csv);
+            }
+            csv << csv::endrow;
+        }
+    };
+
+} // namespace FBExport
+
+#endif // FORMAT_PLAN_H
@@ -0,0 +1,125 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "HexFormat.h"
+#include <cstring>
+
+namespace
+{
+    // Both hex digits of every byte value, so one lookup produces two characters
+    struct HexTable
+    {
+        char lower[256][2];
+        char upper[256][2];
+
+        constexpr HexTable() 
+            : lower()
+            , upper()
+        {
+            constexpr char lowerDigits[] = "0123456789abcdef";
+            constexpr char upperDigits[] = "0123456789ABCDEF";
+            for (unsigned i = 0; i < 256; i++) {
+                lower[i][0] = lowerDigits[i >> 4];
+                lower[i][1] = lowerDigits[i & 0xF];
+                upper[i][0] = upperDigits[i >> 4];
+                upper[i][1] = upperDigits[i & 0xF];
+            }
+        }
+    };
+
+    constexpr HexTable HEX_TABLE;
+
+    inline char* writeUpperByte(char* out, unsigned value)
+    {
+        std::memcpy(out, HEX_TABLE.upper[value & 0xFF], 2);
+        return out + 2;
+    }
+
+    inline char* writeUpper16(char* out, unsigned value)
+    {
+        out = writeUpperByte(out, value >> 8);
+        return writeUpperByte(out, value);
+    }
+} // namespace
+
+namespace FBExport
+{
+
+    char* encodeHex(char* out, const unsigned char* data, size_t length)
+    {
+        const unsigned char* const end = data + length;
+        // 4 bytes per iteration, the copies are merged by the compiler
+        for (; data + 4 <= end; data += 4, out += 8) {
+            std::memcpy(out, HEX_TABLE.lower[data[0]], 2);
+            std::memcpy(out + 2, HEX_TABLE.lower[data[1]], 2);
+            std::memcpy(out + 4, HEX_TABLE.lower[data[2]], 2);
+            std::memcpy(out + 6, HEX_TABLE.lower[data[3]], 2);
+        }
+        for (; data < end; data++, out += 2) {
+            std::memcpy(out, HEX_TABLE.lower[*data], 2);
+        }
+        return out;
+    }
+
+    char* encodeBase64(char* out, const unsigned char* data, size_t length)
+    {
+        constexpr char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        const unsigned char* const end = data + length;
+        for (; data + 3 <= end; data += 3, out += 4) {
+            const unsigned value = (static_cast<unsigned>(data[0]) << 16) | (static_cast<unsigned>(data[1]) << 8) | data[2];
+            out[0] = digits[value >> 18];
+            out[1] = digits[(value >> 12) & 0x3F];
+            out[2] = digits[(value >> 6) & 0x3F];
+            out[3] = digits[value & 0x3F];
+        }
+        if (data < end) {
+            const unsigned value = (static_cast<unsigned>(data[0]) << 16) | (data + 1 < end ? static_cast<unsigned>(data[1]) << 8 : 0);
+            out[0] = digits[value >> 18];
+            out[1] = digits[(value >> 12) & 0x3F];
+            out[2] = data + 1 < end ? digits[(value >> 6) & 0x3F] : '=';
+            out[3] = '=';
+            out += 4;
+        }
+        return out;
+    }
+
+    char* formatGuid(char* out, const Firebird::Guid& guid)
+    {
+        *out++ = '{';
+        out = writeUpper16(out, static_cast<unsigned>(guid.Data1 >> 16));
+        out = writeUpper16(out, static_cast<unsigned>(guid.Data1 & 0xFFFF));
+        *out++ = '-';
+        out = writeUpper16(out, guid.Data2);
+        *out++ = '-';
+        out = writeUpper16(out, guid.Data3);
+        *out++ = '-';
+        out = writeUpperByte(out, guid.Data4[0]);
+        out = writeUpperByte(out, guid.Data4[1]);
+        *out++ = '-';
+        for (unsigned i = 2; i < 8; i++) {
+            out = writeUpperByte(out, guid.Data4[i]);
+        }
+        *out++ = '}';
+        return out;
+    }
+
+} // namespace FBExport
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef HEX_FORMAT_H
+#define HEX_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <cstddef>
+#include "guid.h"
+
+namespace FBExport
+{
+    // "{XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}", same as Firebird::GuidToString
+    inline constexpr size_t GUID_STRING_LENGTH = Firebird::GUID_BUFF_SIZE - 1;
+
+    // Writes the data as lower case hex digits, 2 characters per byte.
+    // Returns the pointer past the last written character.
+    char* encodeHex(char* out, const unsigned char* data, size_t length);
+
+    // Output size of encodeBase64
+    inline constexpr size_t base64Length(size_t length)
+    {
+        return (length + 2) / 3 * 4;
+    }
+
+    // Writes the data in base64 (RFC 4648) with padding and without line breaks.
+    // A value written in parts must be cut at multiples of 3 bytes.
+    // Returns the pointer past the last written character.
+    char* encodeBase64(char* out, const unsigned char* data, size_t length);
+
+    // Writes the GUID in the Firebird::GUID_FORMAT format without printf.
+    // Returns the pointer past the last written character.
+    char* formatGuid(char* out, const Firebird::Guid& guid);
+
+} // namespace FBExport
+
+#endif // HEX_FORMAT_H
@@ -0,0 +1,83 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "NumericFormat.h"
+#include <charconv>
+
+namespace FBExport
+{
+
+    char* formatScaledInt64(char* out, int64_t value, int scale)
+    {
+        char* const last = out + MAX_SCALED_INT64_LENGTH;
+        if (scale >= 0) {
+            // there are no positive scales for exact numerics, just in case
+            return std::to_chars(out, last, value).ptr;
+        }
+        if (scale < -18) {
+            scale = -18;
+        }
+        const auto digits = static_cast<unsigned>(-scale);
+        // the magnitude is taken as unsigned to handle INT64_MIN
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        const auto factor = static_cast<uint64_t>(NUMERIC_FACTORS[digits]);
+        uint64_t intPart = magnitude / factor;
+        uint64_t fracPart = magnitude % factor;
+
+        if (value < 0) {
+            *out++ = '-';
+        }
+        out = std::to_chars(out, last, intPart).ptr;
+        *out++ = '.';
+        // fractional part with leading zeros, filled from the right
+        for (char* p = out + digits - 1; p >= out; --p) {
+            *p = static_cast<char>('0' + fracPart % 10);
+            fracPart /= 10;
+        }
+        return out + digits;
+    }
+
+    template <typename T>
+    char* formatFloatImpl(char* out, T value, int precision)
+    {
+        char* const last = out + floatLength(precision);
+        if (precision >= 0) {
+            auto [ptr, ec] = std::to_chars(out, last, value, std::chars_format::fixed, precision);
+            if (ec == std::errc()) {
+                return ptr;
+            }
+            // too large for the fixed notation, fall back to the shortest form
+        }
+        return std::to_chars(out, last, value).ptr;
+    }
+
+    char* formatFloat(char* out, float value, int precision)
+    {
+        return formatFloatImpl(out, value, precision);
+    }
+
+    char* formatFloat(char* out, double value, int precision)
+    {
+        return formatFloatImpl(out, value, precision);
+    }
+
+} // namespace FBExport
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef NUMERIC_FORMAT_H
+#define NUMERIC_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FBExport
+{
+    inline constexpr int64_t NUMERIC_FACTORS[] = {
+                          0, // 0
+                         10, // 1
+                        100, // 2
+                       1000, // 3
+                      10000, // 4
+                     100000, // 5
+                    1000000, // 6
+                   10000000, // 7
+                  100000000, // 8
+                 1000000000, // 9
+                10000000000, // 10
+               100000000000, // 11
+              1000000000000, // 12
+             10000000000000, // 13
+            100000000000000, // 14
+           1000000000000000, // 15
+          10000000000000000, // 16
+         100000000000000000, // 17
+        1000000000000000000  // 18
+    };
+
+    // Sign, 19 digits, decimal point and leading zero: "-0.9223372036854775808"
+    inline constexpr size_t MAX_SCALED_INT64_LENGTH = 24;
+
+    // Writes an integer value with the given scale (SMALLINT, INTEGER, BIGINT,
+    // NUMERIC and DECIMAL) starting at out. The output is never longer 
+    // than MAX_SCALED_INT64_LENGTH. Returns the pointer past the last written character.
+    char* formatScaledInt64(char* out, int64_t value, int scale);
+
+    // Enough for the shortest representation of any double: "-2.2250738585072014e-308"
+    inline constexpr size_t MAX_FLOAT_LENGTH = 32;
+
+    // Buffer size needed by formatFloat for the given precision
+    inline constexpr size_t floatLength(int precision)
+    {
+        return precision < 0 ? MAX_FLOAT_LENGTH : MAX_FLOAT_LENGTH + static_cast<size_t>(precision);
+    }
+
+    // Writes FLOAT or DOUBLE PRECISION value. With negative precision the shortest 
+    // text that reads back to exactly the same value is written, otherwise the value
+    // is written in fixed notation with the given number of digits after the point.
+    // Returns the pointer past the last written character.
+    char* formatFloat(char* out, float value, int precision);
+
+    char* formatFloat(char* out, double value, int precision);
+
+} // namespace FBExport
+
+#endif // NUMERIC_FORMAT_H
@@ -0,0 +1,120 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include <stdexcept>
+
+namespace csv
+{
+
+    FileSink::FileSink(const fs::path& filename, WriteStats& stats)
+        : fs_()
+        , stats_(stats)
+    {
+        // the stream must stay unbuffered, the buffering is done by OutputBuffer
+        fs_.rdbuf()->pubsetbuf(nullptr, 0);
+        fs_.exceptions(std::ios::failbit | std::ios::badbit);
+        fs_.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+
+    void FileSink::write(const char* data, size_t size)
+    {
+        fs_.write(data, static_cast<std::streamsize>(size));
+        stats_.bytes += size;
+        stats_.syscalls++;
+    }
+
+    void FileSink::close()
+    {
+        if (fs_.is_open()) {
+            fs_.close();
+        }
+    }
+
+    OutputBuffer::OutputBuffer(size_t capacity)
+        : data_(capacity > 0 ? capacity : DEFAULT_BUFFER_SIZE)
+    {
+    }
+
+    void OutputBuffer::attach(OutputSink* sink)
+    {
+        flush();
+        sink_ = sink;
+    }
+
+    void OutputBuffer::detach()
+    {
+        flush();
+        sink_ = nullptr;
+    }
+
+    void OutputBuffer::flush()
+    {
+        if (size_ == 0) {
+            return;
+        }
+        writeSink(data_.data(), size_);
+        size_ = 0;
+    }
+
+    OutputSink& OutputBuffer::sink()
+    {
+        if (!sink_) {
+            throw std::logic_error("Output buffer is not attached to a sink");
+        }
+        return *sink_;
+    }
+
+    void OutputBuffer::writeSink(const char* data, size_t n)
+    {
+        OutputSink& target = sink();
+        const auto start = std::chrono::steady_clock::now();
+        target.write(data, n);
+        writeTime_ += std::chrono::steady_clock::now() - start;
+        written_ += n;
+        if (progress_) {
+            progress_->fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    void OutputBuffer::overflow(size_t n)
+    {
+        flush();
+        // a single value larger than the whole buffer
+        if (n > data_.size()) {
+            data_.resize(n);
+        }
+    }
+
+    void OutputBuffer::appendLong(const char* data, size_t n)
+    {
+        flush();
+        if (n >= data_.size()) {
+            // no sense in copying, pass the data to the sink directly
+            writeSink(data, n);
+            return;
+        }
+        std::memcpy(data_.data(), data, n);
+        size_ = n;
+    }
+
+} // namespace csv
@@ -0,0 +1,212 @@
+#pragma once
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace csv
+{
+    constexpr size_t MIB = 1024 * 1024;
+    constexpr size_t DEFAULT_BUFFER_SIZE = 4 * MIB;
+
+    // I/O counters of one output buffer
+    struct WriteStats
+    {
+        uint64_t bytes = 0;
+        uint64_t syscalls = 0;
+
+        WriteStats& operator += (const WriteStats& other)
+        {
+            bytes += other.bytes;
+            syscalls += other.syscalls;
+            return *this;
+        }
+    };
+
+    // Final destination of the buffered data
+    class OutputSink
+    {
+    public:
+        virtual ~OutputSink() = default;
+
+        virtual void write(const char* data, size_t size) = 0;
+
+        virtual void close() {}
+    };
+
+    // Unbuffered file: every write() is passed to the OS as is
+    class FileSink final : public OutputSink
+    {
+        std::ofstream fs_;
+        WriteStats& stats_;
+    public:
+        FileSink(const fs::path& filename, WriteStats& stats);
+
+        void write(const char* data, size_t size) override;
+
+        void close() override;
+    };
+
+    // Collects the data in memory, the target can be switched between writes
+    class MemorySink final : public OutputSink
+    {
+        std::vector<char>* target_ = nullptr;
+    public:
+        void setTarget(std::vector<char>* target)
+        {
+            target_ = target;
+        }
+
+        void write(const char* data, size_t size) override
+        {
+            target_->insert(target_->end(), data, data + size);
+        }
+    };
+
+    // Large user-space buffer. The data is written to the sink only when the buffer
+    // is full or when flush() is called explicitly. One buffer is owned by each worker
+    // and is reused for all files it exports.
+    class OutputBuffer
+    {
+        std::vector<char> data_;
+        size_t size_ = 0;
+        OutputSink* sink_ = nullptr;
+        WriteStats stats_;
+        // everything passed to the sinks and the time spent in their write()
+        uint64_t written_ = 0;
+        std::chrono::nanoseconds writeTime_{ 0 };
+        std::atomic<uint64_t>* progress_ = nullptr;
+    public:
+        explicit OutputBuffer(size_t capacity = DEFAULT_BUFFER_SIZE);
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        size_t capacity() const
+        {
+            return data_.size();
+        }
+
+        WriteStats& stats()
+        {
+            return stats_;
+        }
+
+        const WriteStats& stats() const
+        {
+            return stats_;
+        }
+
+        uint64_t written() const
+        {
+            return written_;
+        }
+
+        std::chrono::nanoseconds writeTime() const
+        {
+            return writeTime_;
+        }
+
+        // Every write to the sink is also added to the progress counter
+        void setProgress(std::atomic<uint64_t>* progress)
+        {
+            progress_ = progress;
+        }
+
+        void attach(OutputSink* sink);
+
+        void detach();
+
+        void flush();
+
+        // Discards the unwritten data and detaches the sink
+        void reset()
+        {
+            size_ = 0;
+            sink_ = nullptr;
+        }
+
+        // Returns a pointer to at least n free bytes. The caller must confirm
+        // the number of bytes actually written by calling commit().
+        char* reserve(size_t n)
+        {
+            if (data_.size() - size_ < n) {
+                overflow(n);
+            }
+            return data_.data() + size_;
+        }
+
+        void commit(size_t n)
+        {
+            size_ += n;
+        }
+
+        // Same as commit(), end is the pointer past the last written byte
+        void commitTo(const char* end)
+        {
+            size_ = static_cast<size_t>(end - data_.data());
+        }
+
+        void put(char c)
+        {
+            if (size_ == data_.size()) {
+                flush();
+            }
+            data_[size_++] = c;
+        }
+
+        void append(const char* data, size_t n)
+        {
+            if (data_.size() - size_ >= n) {
+                std::memcpy(data_.data() + size_, data, n);
+                size_ += n;
+            }
+            else {
+                appendLong(data, n);
+            }
+        }
+    private:
+        OutputSink& sink();
+
+        void writeSink(const char* data, size_t n);
+
+        void overflow(size_t n);
+
+        void appendLong(const char* data, size_t n);
+    };
+
+} // namespace csv
+
+#endif // OUTPUT_BUFFER_H
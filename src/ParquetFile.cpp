@@ -0,0 +1,1067 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "ParquetFile.h"
+#include "DecimalFormat.h"
+#include "HexFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+    // Values of the Parquet format definitions (parquet.thrift)
+    enum PhysicalType : int32_t
+    {
+        TYPE_BOOLEAN = 0, TYPE_INT32 = 1, TYPE_INT64 = 2, TYPE_FLOAT = 4, TYPE_DOUBLE = 5,
+        TYPE_BYTE_ARRAY = 6, TYPE_FIXED_LEN_BYTE_ARRAY = 7
+    };
+    enum ConvertedType : int32_t
+    {
+        CONVERTED_NONE = -1, CONVERTED_UTF8 = 0, CONVERTED_DECIMAL = 5, CONVERTED_DATE = 6,
+        CONVERTED_TIME_MICROS = 8, CONVERTED_TIMESTAMP_MICROS = 10,
+        CONVERTED_INT_16 = 16, CONVERTED_INT_32 = 17, CONVERTED_INT_64 = 18
+    };
+    enum Encoding : int32_t { ENCODING_PLAIN = 0, ENCODING_RLE = 3, ENCODING_RLE_DICTIONARY = 8 };
+    enum PageType : int32_t { PAGE_DATA = 0, PAGE_DICTIONARY = 2 };
+    enum Codec : int32_t { CODEC_UNCOMPRESSED = 0, CODEC_GZIP = 2, CODEC_ZSTD = 6 };
+    // Members of the LogicalType union
+    enum class Logical { NONE, STRING, INTEGER, DECIMAL, DATE, TIME, TIMESTAMP, UUID };
+
+    constexpr char PARQUET_MAGIC[4] = { 'P', 'A', 'R', '1' };
+    constexpr char CREATED_BY[] = "CSVExport version 1.0.0";
+    // the row group size is checked once per this number of rows
+    constexpr uint64_t ROW_GROUP_CHECK_ROWS = 1024;
+
+    // Firebird dates are counted from 1858-11-17, Parquet dates from 1970-01-01
+    constexpr int64_t UNIX_EPOCH_DATE = 40587;
+    constexpr int64_t MICROS_PER_DAY = 86400LL * 1000000;
+    // ISC_TIME is in 1/10000 of a second
+    constexpr int64_t MICROS_PER_TIME_UNIT = 100;
+
+    // Types of the Thrift compact protocol
+    enum CompactType : uint8_t
+    {
+        CT_BOOLEAN_TRUE = 1, CT_BOOLEAN_FALSE = 2, CT_BYTE = 3, CT_I32 = 5, CT_I64 = 6,
+        CT_BINARY = 8, CT_LIST = 9, CT_STRUCT = 12
+    };
+
+    void putVarint(std::vector<char>& out, uint64_t value)
+    {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void putLittleEndian(std::vector<char>& out, uint64_t value, unsigned bytes)
+    {
+        for (unsigned i = 0; i < bytes; i++) {
+            out.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+
+    // The page headers and the footer are Thrift structures in the compact protocol.
+    // Only the writing of the parts used by Parquet is implemented.
+    class CompactWriter final
+    {
+        std::vector<char>& m_out;
+        std::vector<int16_t> m_parents;
+        int16_t m_lastField = 0;
+    public:
+        explicit CompactWriter(std::vector<char>& out)
+            : m_out(out)
+        {}
+
+        void i32(int16_t id, int32_t value)
+        {
+            field(id, CT_I32);
+            zigzag(value);
+        }
+
+        void i64(int16_t id, int64_t value)
+        {
+            field(id, CT_I64);
+            zigzag(value);
+        }
+
+        void byte(int16_t id, int8_t value)
+        {
+            field(id, CT_BYTE);
+            m_out.push_back(static_cast<char>(value));
+        }
+
+        void boolean(int16_t id, bool value)
+        {
+            field(id, value ? CT_BOOLEAN_TRUE : CT_BOOLEAN_FALSE);
+        }
+
+        void binary(int16_t id, std::string_view value)
+        {
+            field(id, CT_BINARY);
+            element(value);
+        }
+
+        void beginStruct(int16_t id)
+        {
+            field(id, CT_STRUCT);
+            beginElement();
+        }
+
+        // An empty structure, the members of the unions have no fields
+        void emptyStruct(int16_t id)
+        {
+            beginStruct(id);
+            endStruct();
+        }
+
+        void endStruct()
+        {
+            m_out.push_back(0);
+            m_lastField = m_parents.back();
+            m_parents.pop_back();
+        }
+
+        void list(int16_t id, CompactType type, size_t size)
+        {
+            field(id, CT_LIST);
+            if (size < 15) {
+                m_out.push_back(static_cast<char>((size << 4) | type));
+            }
+            else {
+                m_out.push_back(static_cast<char>(0xF0 | type));
+                putVarint(m_out, size);
+            }
+        }
+
+        // Elements of the lists
+        void element(int32_t value)
+        {
+            zigzag(value);
+        }
+
+        void element(std::string_view value)
+        {
+            putVarint(m_out, value.size());
+            m_out.insert(m_out.end(), value.begin(), value.end());
+        }
+
+        void beginElement()
+        {
+            m_parents.push_back(m_lastField);
+            m_lastField = 0;
+        }
+
+        // The end of the top level structure
+        void end()
+        {
+            m_out.push_back(0);
+        }
+    private:
+        void field(int16_t id, CompactType type)
+        {
+            const int delta = id - m_lastField;
+            if (delta > 0 && delta <= 15) {
+                m_out.push_back(static_cast<char>((delta << 4) | type));
+            }
+            else {
+                m_out.push_back(static_cast<char>(type));
+                zigzag(id);
+            }
+            m_lastField = id;
+        }
+
+        void zigzag(int64_t value)
+        {
+            putVarint(m_out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+    };
+
+    // Appends the values packed by bitWidth bits, the least significant bit first.
+    // The count is padded with zeros to the multiple of 8.
+    template <typename T>
+    void packBits(std::vector<char>& out, const T* values, size_t count, size_t paddedCount, unsigned bitWidth)
+    {
+        uint64_t acc = 0;
+        unsigned bits = 0;
+        for (size_t i = 0; i < paddedCount; i++) {
+            acc |= static_cast<uint64_t>(i < count ? values[i] : 0) << bits;
+            bits += bitWidth;
+            while (bits >= 8) {
+                out.push_back(static_cast<char>(acc & 0xFF));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) {
+            out.push_back(static_cast<char>(acc & 0xFF));
+        }
+    }
+
+    // Number of equal values from the position, counting stops at the limit
+    template <typename T>
+    size_t runLength(const std::vector<T>& values, size_t from, size_t limit)
+    {
+        size_t length = 1;
+        while (from + length < values.size() && length < limit && values[from + length] == values[from]) {
+            length++;
+        }
+        return length;
+    }
+
+    // RLE / bit-packing hybrid encoding of the definition levels and the dictionary indices.
+    // Runs of 8 or more equal values are RLE runs, the rest are bit-packed in groups of 8.
+    template <typename T>
+    void encodeHybrid(std::vector<char>& out, const std::vector<T>& values, unsigned bitWidth)
+    {
+        const size_t count = values.size();
+        const unsigned valueBytes = (bitWidth + 7) / 8;
+        size_t i = 0;
+        while (i < count) {
+            const size_t run = runLength(values, i, count);
+            if (run >= 8) {
+                putVarint(out, static_cast<uint64_t>(run) << 1);
+                putLittleEndian(out, values[i], valueBytes);
+                i += run;
+                continue;
+            }
+            // the groups end where a long run starts
+            size_t end = i + 8;
+            while (end < count && runLength(values, end, 8) < 8) {
+                end += 8;
+            }
+            const size_t groups = (end - i) / 8;
+            putVarint(out, (static_cast<uint64_t>(groups) << 1) | 1);
+            packBits(out, values.data() + i, std::min(end, count) - i, groups * 8, bitWidth);
+            i = end;
+        }
+    }
+
+    unsigned bitWidthOf(uint64_t maxValue)
+    {
+        unsigned width = 0;
+        while (maxValue > 0) {
+            width++;
+            maxValue >>= 1;
+        }
+        return width;
+    }
+
+    Codec codecOf(csv::Compression compression)
+    {
+        switch (compression) {
+        case csv::Compression::GZIP:
+            return CODEC_GZIP;
+        case csv::Compression::ZSTD:
+            return CODEC_ZSTD;
+        default:
+            return CODEC_UNCOMPRESSED;
+        }
+    }
+
+    template <typename T>
+    T readValue(const unsigned char* value)
+    {
+        T result;
+        std::memcpy(&result, value, sizeof(T));
+        return result;
+    }
+} // namespace
+
+namespace FBExport
+{
+    // Position of a column chunk in the file
+    struct ParquetChunk
+    {
+        int64_t dataPageOffset = 0;
+        int64_t dictionaryPageOffset = -1;
+        int64_t values = 0;
+        int64_t uncompressedSize = 0;
+        int64_t compressedSize = 0;
+        bool plain = false;
+        bool dictionary = false;
+    };
+
+    using ParquetAppendFunc = void (*)(ParquetColumn& column, FormatContext& ctx, const unsigned char* value);
+
+    // Schema of a column and its values in the current row group. The values are encoded
+    // into pages as they come, the pages of the row group are kept until it is written.
+    class ParquetColumn
+    {
+    public:
+        std::string name;
+        PhysicalType type = TYPE_BYTE_ARRAY;
+        int32_t typeLength = 0;
+        ConvertedType converted = CONVERTED_NONE;
+        Logical logical = Logical::NONE;
+        int32_t scale = 0;
+        int32_t precision = 0;
+        int8_t bitWidth = 0;
+        bool utc = false;
+        bool optional = true;
+
+        ParquetAppendFunc append = nullptr;
+        unsigned offset = 0;
+        unsigned nullOffset = 0;
+        unsigned length = 0;
+        std::string blob;
+
+        std::vector<ParquetChunk> chunks;
+    private:
+        const ParquetOptions* m_options = nullptr;
+        bool m_useDictionary = false;
+        // the current page
+        std::vector<uint8_t> m_levels;
+        std::vector<char> m_values;
+        std::vector<uint32_t> m_indices;
+        size_t m_pageValues = 0;
+        // the dictionary and the finished pages of the current column chunk
+        std::unordered_map<std::string, uint32_t> m_dictionary;
+        std::vector<char> m_dictionaryValues;
+        std::vector<char> m_pages;
+        ParquetChunk m_chunk;
+        std::vector<char> m_body;
+        std::vector<char> m_compressed;
+        std::vector<char> m_header;
+    public:
+        void setOptions(const ParquetOptions& options)
+        {
+            m_options = &options;
+            m_useDictionary = options.dictionary && type == TYPE_BYTE_ARRAY;
+        }
+
+        const ParquetOptions& options() const
+        {
+            return *m_options;
+        }
+
+        void addNull()
+        {
+            m_levels.push_back(0);
+            m_pageValues++;
+        }
+
+        void addPlain(const void* data, size_t size)
+        {
+            beginValue();
+            const char* bytes = static_cast<const char*>(data);
+            m_values.insert(m_values.end(), bytes, bytes + size);
+        }
+
+        // BYTE_ARRAY value, the dictionary index while the dictionary is used
+        void addBytes(const char* data, size_t size)
+        {
+            beginValue();
+            if (!m_useDictionary) {
+                putLittleEndian(m_values, size, 4);
+                m_values.insert(m_values.end(), data, data + size);
+                return;
+            }
+            auto [it, inserted] = m_dictionary.try_emplace(std::string(data, size), static_cast<uint32_t>(m_dictionary.size()));
+            m_indices.push_back(it->second);
+            if (inserted) {
+                putLittleEndian(m_dictionaryValues, size, 4);
+                m_dictionaryValues.insert(m_dictionaryValues.end(), data, data + size);
+                if (m_dictionaryValues.size() > PARQUET_DICTIONARY_SIZE) {
+                    // the page encoded with the dictionary is finished, plain pages follow it
+                    writePage();
+                    m_useDictionary = false;
+                }
+            }
+        }
+
+        // Size of the column in the current row group before compression
+        size_t size() const
+        {
+            return static_cast<size_t>(m_chunk.uncompressedSize) + pageSize() + m_dictionaryValues.size();
+        }
+
+        void finishValue()
+        {
+            if (pageSize() >= PARQUET_PAGE_SIZE) {
+                writePage();
+            }
+        }
+
+        // Writes the column chunk of the row group, the position is moved past it
+        void writeChunk(csv::OutputBuffer& buffer, uint64_t& position)
+        {
+            writePage();
+            ParquetChunk chunk = m_chunk;
+            if (chunk.dictionary) {
+                chunk.dictionaryPageOffset = static_cast<int64_t>(position);
+                const auto& body = encodePage(m_dictionaryValues, PAGE_DICTIONARY, static_cast<int32_t>(m_dictionary.size()), ENCODING_PLAIN);
+                const size_t headerSize = m_header.size();
+                buffer.append(m_header.data(), m_header.size());
+                buffer.append(body.data(), body.size());
+                chunk.uncompressedSize += static_cast<int64_t>(headerSize + m_dictionaryValues.size());
+                chunk.compressedSize += static_cast<int64_t>(headerSize + body.size());
+                position += headerSize + body.size();
+                chunk.plain = true;
+            }
+            chunk.dataPageOffset = static_cast<int64_t>(position);
+            buffer.append(m_pages.data(), m_pages.size());
+            position += m_pages.size();
+            chunks.push_back(chunk);
+
+            m_chunk = ParquetChunk();
+            m_pages.clear();
+            m_dictionary.clear();
+            m_dictionaryValues.clear();
+            m_useDictionary = m_options->dictionary && type == TYPE_BYTE_ARRAY;
+        }
+    private:
+        void beginValue()
+        {
+            if (optional) {
+                m_levels.push_back(1);
+            }
+            m_pageValues++;
+        }
+
+        size_t pageSize() const
+        {
+            return m_values.size() + m_indices.size() * sizeof(uint32_t) + m_levels.size() / 8;
+        }
+
+        const std::vector<char>& compressed(const std::vector<char>& body)
+        {
+            if (m_options->compression == csv::Compression::NONE) {
+                return body;
+            }
+            csv::compressBlock(m_options->compression, m_options->compressLevel, body.data(), body.size(), m_compressed);
+            return m_compressed;
+        }
+
+        // The page header is written to m_header, returns the compressed body
+        const std::vector<char>& encodePage(const std::vector<char>& body, PageType pageType, int32_t values, Encoding encoding)
+        {
+            const auto& data = compressed(body);
+            m_header.clear();
+            CompactWriter writer(m_header);
+            writer.i32(1, pageType);
+            writer.i32(2, static_cast<int32_t>(body.size()));
+            writer.i32(3, static_cast<int32_t>(data.size()));
+            if (pageType == PAGE_DICTIONARY) {
+                writer.beginStruct(7);
+                writer.i32(1, values);
+                writer.i32(2, encoding);
+            }
+            else {
+                writer.beginStruct(5);
+                writer.i32(1, values);
+                writer.i32(2, encoding);
+                writer.i32(3, ENCODING_RLE);
+                writer.i32(4, ENCODING_RLE);
+            }
+            writer.endStruct();
+            writer.end();
+            return data;
+        }
+
+        void writePage()
+        {
+            if (m_pageValues == 0) {
+                return;
+            }
+            m_body.clear();
+            if (optional) {
+                // the definition levels of the data page v1 are prefixed by their length
+                m_body.resize(4);
+                encodeHybrid(m_body, m_levels, 1);
+                const auto levelsSize = static_cast<uint32_t>(m_body.size() - 4);
+                for (unsigned i = 0; i < 4; i++) {
+                    m_body[i] = static_cast<char>(levelsSize >> (8 * i));
+                }
+            }
+            // a page of NULL values only has no indices and is written as plain
+            const bool dictionary = m_useDictionary && !m_indices.empty();
+            if (dictionary) {
+                const unsigned bitWidth = std::max(1u, bitWidthOf(m_dictionary.size() - 1));
+                m_body.push_back(static_cast<char>(bitWidth));
+                encodeHybrid(m_body, m_indices, bitWidth);
+            }
+            else if (type == TYPE_BOOLEAN) {
+                packBits(m_body, reinterpret_cast<const uint8_t*>(m_values.data()), m_values.size(), m_values.size(), 1);
+            }
+            else {
+                m_body.insert(m_body.end(), m_values.begin(), m_values.end());
+            }
+
+            const auto& body = encodePage(m_body, PAGE_DATA, static_cast<int32_t>(m_pageValues), dictionary ? ENCODING_RLE_DICTIONARY : ENCODING_PLAIN);
+            m_pages.insert(m_pages.end(), m_header.begin(), m_header.end());
+            m_pages.insert(m_pages.end(), body.begin(), body.end());
+            m_chunk.values += static_cast<int64_t>(m_pageValues);
+            m_chunk.uncompressedSize += static_cast<int64_t>(m_header.size() + m_body.size());
+            m_chunk.compressedSize += static_cast<int64_t>(m_header.size() + body.size());
+            m_chunk.dictionary = m_chunk.dictionary || dictionary;
+            m_chunk.plain = m_chunk.plain || !dictionary;
+
+            // the dictionary does not pay off if most values of the first page are distinct
+            if (dictionary && m_chunk.values == static_cast<int64_t>(m_pageValues) && m_dictionary.size() * 2 > m_indices.size()) {
+                m_useDictionary = false;
+            }
+            m_levels.clear();
+            m_values.clear();
+            m_indices.clear();
+            m_pageValues = 0;
+        }
+    };
+
+} // namespace FBExport
+
+namespace
+{
+    using FBExport::FormatContext;
+    using FBExport::ParquetColumn;
+
+    constexpr char WHITESPACE[] = " \n\r\t\f\v";
+
+    size_t rtrimLength(const char* s, size_t length)
+    {
+        while (length > 0 && s[length - 1] != '\0' && std::strchr(WHITESPACE, s[length - 1])) {
+            length--;
+        }
+        return length;
+    }
+
+    void appendNull(ParquetColumn& column, FormatContext&, const unsigned char*)
+    {
+        column.addNull();
+    }
+
+    void appendBoolean(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const uint8_t flag = *value ? 1 : 0;
+        column.addPlain(&flag, sizeof(flag));
+    }
+
+    // Converts the value to the Parquet physical type, the little-endian byte order is assumed
+    template <typename From, typename To>
+    void appendNumber(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto number = static_cast<To>(readValue<From>(value));
+        column.addPlain(&number, sizeof(number));
+    }
+
+    // DECIMAL in FIXED_LEN_BYTE_ARRAY is a big-endian two's complement number
+    void appendInt128(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto number = readValue<FB_I128_t>(value);
+        char bytes[16];
+        for (unsigned i = 0; i < 8; i++) {
+            bytes[i] = static_cast<char>(number.fb_data[1] >> (56 - 8 * i));
+            bytes[8 + i] = static_cast<char>(number.fb_data[0] >> (56 - 8 * i));
+        }
+        column.addPlain(bytes, sizeof(bytes));
+    }
+
+    // NUMERIC(18) holds any BIGINT, 19 digits do not fit the DECIMAL in INT64,
+    // so the value is a 9-byte big-endian number with the sign byte in front
+    void appendScaledInt64(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto number = static_cast<uint64_t>(readValue<int64_t>(value));
+        char bytes[9];
+        bytes[0] = static_cast<char>(number >> 63 ? 0xFF : 0);
+        for (unsigned i = 0; i < 8; i++) {
+            bytes[1 + i] = static_cast<char>(number >> (56 - 8 * i));
+        }
+        column.addPlain(bytes, sizeof(bytes));
+    }
+
+    int64_t toMicros(ISC_DATE date, ISC_TIME time)
+    {
+        return (static_cast<int64_t>(date) - UNIX_EPOCH_DATE) * MICROS_PER_DAY + static_cast<int64_t>(time) * MICROS_PER_TIME_UNIT;
+    }
+
+    void appendDate(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto days = static_cast<int32_t>(readValue<ISC_DATE>(value) - UNIX_EPOCH_DATE);
+        column.addPlain(&days, sizeof(days));
+    }
+
+    // ISC_TIME_TZ and ISC_TIME_TZ_EX start with the UTC time
+    void appendTime(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto micros = static_cast<int64_t>(readValue<ISC_TIME>(value)) * MICROS_PER_TIME_UNIT;
+        column.addPlain(&micros, sizeof(micros));
+    }
+
+    void appendTimestamp(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP>(value);
+        const int64_t micros = toMicros(ts.timestamp_date, ts.timestamp_time);
+        column.addPlain(&micros, sizeof(micros));
+    }
+
+    // ISC_TIMESTAMP_TZ and ISC_TIMESTAMP_TZ_EX start with the UTC timestamp
+    void appendUtcTimestamp(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto ts = readValue<ISC_TIMESTAMP_TZ>(value).utc_timestamp;
+        const int64_t micros = toMicros(ts.timestamp_date, ts.timestamp_time);
+        column.addPlain(&micros, sizeof(micros));
+    }
+
+    void appendChar(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        // CHAR(N)
+        auto s = reinterpret_cast<const char*>(value);
+        column.addBytes(s, rtrimLength(s, column.length));
+    }
+
+    void appendBinary(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        // BINARY(N)
+        column.addPlain(value, column.length);
+    }
+
+    // UUID is stored in the order of its text form, Data1..Data3 of Guid are in the host order
+    void appendGuid(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        const auto guid = readValue<Firebird::Guid>(value);
+        unsigned char bytes[16];
+        for (unsigned i = 0; i < 4; i++) {
+            bytes[i] = static_cast<unsigned char>(guid.Data1 >> (24 - 8 * i));
+        }
+        bytes[4] = static_cast<unsigned char>(guid.Data2 >> 8);
+        bytes[5] = static_cast<unsigned char>(guid.Data2);
+        bytes[6] = static_cast<unsigned char>(guid.Data3 >> 8);
+        bytes[7] = static_cast<unsigned char>(guid.Data3);
+        std::memcpy(bytes + 8, guid.Data4, sizeof(guid.Data4));
+        column.addPlain(bytes, sizeof(bytes));
+    }
+
+    void appendVarChar(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        // VARCHAR(N) and VARBINARY(N)
+        auto len = readValue<unsigned short>(value);
+        column.addBytes(reinterpret_cast<const char*>(value + 2), len);
+    }
+
+    void appendDec16(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        char out[FBExport::MAX_DECFLOAT16_LENGTH];
+        const char* end = FBExport::formatDecFloat16(out, readValue<FB_DEC16_t>(value));
+        column.addBytes(out, static_cast<size_t>(end - out));
+    }
+
+    void appendDec34(ParquetColumn& column, FormatContext&, const unsigned char* value)
+    {
+        char out[FBExport::MAX_DECFLOAT34_LENGTH];
+        const char* end = FBExport::formatDecFloat34(out, readValue<FB_DEC34_t>(value));
+        column.addBytes(out, static_cast<size_t>(end - out));
+    }
+
+    void appendBlob(ParquetColumn& column, FormatContext& ctx, const unsigned char* value)
+    {
+        ctx.blobs->read(ctx.status, ctx.att, ctx.tra, readValue<ISC_QUAD>(value), column.blob);
+        column.addBytes(column.blob.data(), column.blob.size());
+    }
+
+    void setInteger(ParquetColumn& column, PhysicalType type, int8_t bitWidth, ConvertedType converted, int scale, int32_t precision)
+    {
+        column.type = type;
+        if (scale == 0) {
+            column.logical = Logical::INTEGER;
+            column.bitWidth = bitWidth;
+            column.converted = converted;
+        }
+        else {
+            column.logical = Logical::DECIMAL;
+            column.converted = CONVERTED_DECIMAL;
+            column.scale = -scale;
+            column.precision = precision;
+        }
+    }
+
+    void setString(ParquetColumn& column, bool text, const FBExport::ParquetOptions& options)
+    {
+        column.type = TYPE_BYTE_ARRAY;
+        if (text && options.utf8) {
+            column.logical = Logical::STRING;
+            column.converted = CONVERTED_UTF8;
+        }
+    }
+
+    void setTime(ParquetColumn& column, Logical logical, bool utc)
+    {
+        column.type = TYPE_INT64;
+        column.logical = logical;
+        column.utc = utc;
+        // the converted types have no local time, they are for the UTC values only
+        if (utc) {
+            column.converted = logical == Logical::TIME ? CONVERTED_TIME_MICROS : CONVERTED_TIMESTAMP_MICROS;
+        }
+    }
+
+    // Chooses the Parquet type of the column and the function that appends its values,
+    // the same way FormatPlan chooses the CSV formatter.
+    void chooseType(ParquetColumn& column, const Firebird::SQLDA& field, const FBExport::ParquetOptions& options)
+    {
+        column.optional = field.nullable;
+        switch (field.type) {
+        case SQL_BOOLEAN:
+            column.type = TYPE_BOOLEAN;
+            column.append = appendBoolean;
+            return;
+        case SQL_TEXT:
+            if (field.charset == 1) {
+                column.type = TYPE_FIXED_LEN_BYTE_ARRAY;
+                column.typeLength = static_cast<int32_t>(field.length);
+                if (field.length == sizeof(Firebird::Guid)) {
+                    column.logical = Logical::UUID;
+                    column.append = appendGuid;
+                }
+                else {
+                    column.append = appendBinary;
+                }
+                return;
+            }
+            setString(column, true, options);
+            column.append = appendChar;
+            return;
+        case SQL_VARYING:
+            setString(column, field.charset != 1, options);
+            column.append = appendVarChar;
+            return;
+        case SQL_SHORT:
+            setInteger(column, TYPE_INT32, 16, CONVERTED_INT_16, field.scale, 5);
+            column.append = appendNumber<short, int32_t>;
+            return;
+        case SQL_LONG:
+            if (field.scale == 0) {
+                setInteger(column, TYPE_INT32, 32, CONVERTED_INT_32, field.scale, 0);
+                column.append = appendNumber<int32_t, int32_t>;
+            }
+            else {
+                // NUMERIC(9) may hold 10 digits, more than the DECIMAL in INT32
+                setInteger(column, TYPE_INT64, 32, CONVERTED_INT_32, field.scale, 10);
+                column.append = appendNumber<int32_t, int64_t>;
+            }
+            return;
+        case SQL_INT64:
+            if (field.scale == 0) {
+                setInteger(column, TYPE_INT64, 64, CONVERTED_INT_64, field.scale, 0);
+                column.append = appendNumber<int64_t, int64_t>;
+            }
+            else {
+                setInteger(column, TYPE_FIXED_LEN_BYTE_ARRAY, 64, CONVERTED_INT_64, field.scale, 19);
+                column.typeLength = 9;
+                column.append = appendScaledInt64;
+            }
+            return;
+        case SQL_INT128:
+            column.type = TYPE_FIXED_LEN_BYTE_ARRAY;
+            column.typeLength = 16;
+            column.logical = Logical::DECIMAL;
+            column.converted = CONVERTED_DECIMAL;
+            column.scale = -field.scale;
+            column.precision = 38;
+            column.append = appendInt128;
+            return;
+        case SQL_FLOAT:
+            column.type = TYPE_FLOAT;
+            column.append = appendNumber<float, float>;
+            return;
+        case SQL_D_FLOAT:
+        case SQL_DOUBLE:
+            column.type = TYPE_DOUBLE;
+            column.append = appendNumber<double, double>;
+            return;
+        case SQL_TYPE_DATE:
+            column.type = TYPE_INT32;
+            column.logical = Logical::DATE;
+            column.converted = CONVERTED_DATE;
+            column.append = appendDate;
+            return;
+        case SQL_TYPE_TIME:
+            setTime(column, Logical::TIME, false);
+            column.append = appendTime;
+            return;
+        case SQL_TIMESTAMP:
+            setTime(column, Logical::TIMESTAMP, false);
+            column.append = appendTimestamp;
+            return;
+        case SQL_TIME_TZ:
+        case SQL_TIME_TZ_EX:
+            setTime(column, Logical::TIME, true);
+            column.append = appendTime;
+            return;
+        case SQL_TIMESTAMP_TZ:
+        case SQL_TIMESTAMP_TZ_EX:
+            setTime(column, Logical::TIMESTAMP, true);
+            column.append = appendUtcTimestamp;
+            return;
+        case SQL_DEC16:
+            setString(column, true, FBExport::ParquetOptions());
+            column.append = appendDec16;
+            return;
+        case SQL_DEC34:
+            setString(column, true, FBExport::ParquetOptions());
+            column.append = appendDec34;
+            return;
+        case SQL_BLOB:
+            setString(column, field.sub_type == isc_blob_text, options);
+            column.append = appendBlob;
+            return;
+        case SQL_ARRAY:
+        default:
+            column.type = TYPE_BYTE_ARRAY;
+            column.optional = true;
+            column.append = appendNull;
+            return;
+        }
+    }
+
+    void writeLogicalType(CompactWriter& writer, const ParquetColumn& column)
+    {
+        writer.beginStruct(10);
+        switch (column.logical) {
+        case Logical::STRING:
+            writer.emptyStruct(1);
+            break;
+        case Logical::DECIMAL:
+            writer.beginStruct(5);
+            writer.i32(1, column.scale);
+            writer.i32(2, column.precision);
+            writer.endStruct();
+            break;
+        case Logical::DATE:
+            writer.emptyStruct(6);
+            break;
+        case Logical::TIME:
+        case Logical::TIMESTAMP:
+            writer.beginStruct(column.logical == Logical::TIME ? 7 : 8);
+            writer.boolean(1, column.utc);
+            // TimeUnit.MICROS
+            writer.beginStruct(2);
+            writer.emptyStruct(2);
+            writer.endStruct();
+            writer.endStruct();
+            break;
+        case Logical::INTEGER:
+            writer.beginStruct(10);
+            writer.byte(1, column.bitWidth);
+            writer.boolean(2, true);
+            writer.endStruct();
+            break;
+        case Logical::UUID:
+            writer.emptyStruct(14);
+            break;
+        default:
+            break;
+        }
+        writer.endStruct();
+    }
+
+    void writeSchemaElement(CompactWriter& writer, const ParquetColumn& column)
+    {
+        writer.beginElement();
+        writer.i32(1, column.type);
+        if (column.type == TYPE_FIXED_LEN_BYTE_ARRAY) {
+            writer.i32(2, column.typeLength);
+        }
+        // REQUIRED or OPTIONAL
+        writer.i32(3, column.optional ? 1 : 0);
+        writer.binary(4, column.name);
+        if (column.converted != CONVERTED_NONE) {
+            writer.i32(6, column.converted);
+        }
+        if (column.logical == Logical::DECIMAL) {
+            writer.i32(7, column.scale);
+            writer.i32(8, column.precision);
+        }
+        if (column.logical != Logical::NONE) {
+            writeLogicalType(writer, column);
+        }
+        writer.endStruct();
+    }
+
+    void writeColumnChunk(CompactWriter& writer, const ParquetColumn& column, const FBExport::ParquetChunk& chunk, Codec codec)
+    {
+        writer.beginElement();
+        const int64_t chunkOffset = chunk.dictionaryPageOffset >= 0 ? chunk.dictionaryPageOffset : chunk.dataPageOffset;
+        writer.i64(2, chunkOffset);
+        writer.beginStruct(3);
+        writer.i32(1, column.type);
+        const size_t encodings = 1 + (chunk.plain ? 1 : 0) + (chunk.dictionary ? 1 : 0);
+        writer.list(2, CT_I32, encodings);
+        writer.element(ENCODING_RLE);
+        if (chunk.plain) {
+            writer.element(ENCODING_PLAIN);
+        }
+        if (chunk.dictionary) {
+            writer.element(ENCODING_RLE_DICTIONARY);
+        }
+        writer.list(3, CT_BINARY, 1);
+        writer.element(column.name);
+        writer.i32(4, codec);
+        writer.i64(5, chunk.values);
+        writer.i64(6, chunk.uncompressedSize);
+        writer.i64(7, chunk.compressedSize);
+        writer.i64(9, chunk.dataPageOffset);
+        if (chunk.dictionaryPageOffset >= 0) {
+            writer.i64(11, chunk.dictionaryPageOffset);
+        }
+        writer.endStruct();
+        writer.endStruct();
+    }
+} // namespace
+
+namespace FBExport
+{
+    ParquetFile::ParquetFile(
+        csv::OutputSink& sink,
+        csv::OutputBuffer& buffer,
+        const Firebird::SQLDAList& fields,
+        const Firebird::SQLDANameList& names,
+        const ParquetOptions& options)
+        : m_buffer(buffer)
+        , m_options(options)
+    {
+        m_columns.reserve(fields.size());
+        for (size_t i = 0; i < fields.size(); i++) {
+            const auto& field = fields[i];
+            auto column = std::make_unique<ParquetColumn>();
+            column->name = i < names.size() ? names[i].field : std::string();
+            if (column->name.empty()) {
+                column->name = "COLUMN" + std::to_string(i + 1);
+            }
+            chooseType(*column, field, m_options);
+            column->offset = field.offset;
+            column->nullOffset = field.nullOffset;
+            column->length = field.length;
+            column->setOptions(m_options);
+            m_columns.push_back(std::move(column));
+        }
+        m_buffer.attach(&sink);
+        append(std::vector<char>(std::begin(PARQUET_MAGIC), std::end(PARQUET_MAGIC)));
+    }
+
+    ParquetFile::~ParquetFile()
+    {
+        if (!m_closed) {
+            m_buffer.reset();
+        }
+    }
+
+    void ParquetFile::writeRow(FormatContext& ctx, const unsigned char* message)
+    {
+        for (auto& column : m_columns) {
+            if (column->optional && *reinterpret_cast<const short*>(message + column->nullOffset)) {
+                column->addNull();
+            }
+            else {
+                column->append(*column, ctx, message + column->offset);
+            }
+            column->finishValue();
+        }
+        m_groupRows++;
+        if (m_groupRows % ROW_GROUP_CHECK_ROWS != 0) {
+            return;
+        }
+        size_t size = 0;
+        for (const auto& column : m_columns) {
+            size += column->size();
+        }
+        if (size >= m_options.rowGroupSize) {
+            writeRowGroup();
+        }
+    }
+
+    void ParquetFile::close()
+    {
+        if (m_closed) {
+            return;
+        }
+        if (m_groupRows > 0) {
+            writeRowGroup();
+        }
+        writeFooter();
+        m_closed = true;
+        m_buffer.detach();
+    }
+
+    void ParquetFile::writeRowGroup()
+    {
+        for (auto& column : m_columns) {
+            column->writeChunk(m_buffer, m_position);
+        }
+        m_groups.push_back(m_groupRows);
+        m_groupRows = 0;
+    }
+
+    void ParquetFile::writeFooter()
+    {
+        std::vector<char> footer;
+        CompactWriter writer(footer);
+        writer.i32(1, 1);
+
+        writer.list(2, CT_STRUCT, m_columns.size() + 1);
+        writer.beginElement();
+        writer.binary(4, "schema");
+        writer.i32(5, static_cast<int32_t>(m_columns.size()));
+        writer.endStruct();
+        for (const auto& column : m_columns) {
+            writeSchemaElement(writer, *column);
+        }
+
+        uint64_t rows = 0;
+        for (auto groupRows : m_groups) {
+            rows += groupRows;
+        }
+        writer.i64(3, static_cast<int64_t>(rows));
+
+        const Codec codec = codecOf(m_options.compression);
+        writer.list(4, CT_STRUCT, m_groups.size());
+        for (size_t i = 0; i < m_groups.size(); i++) {
+            writer.beginElement();
+            writer.list(1, CT_STRUCT, m_columns.size());
+            int64_t groupSize = 0;
+            for (const auto& column : m_columns) {
+                writeColumnChunk(writer, *column, column->chunks[i], codec);
+                groupSize += column->chunks[i].uncompressedSize;
+            }
+            writer.i64(2, groupSize);
+            writer.i64(3, static_cast<int64_t>(m_groups[i]));
+            writer.endStruct();
+        }
+        writer.binary(6, CREATED_BY);
+        writer.end();
+
+        const auto footerLength = static_cast<uint32_t>(footer.size());
+        putLittleEndian(footer, footerLength, 4);
+        footer.insert(footer.end(), std::begin(PARQUET_MAGIC), std::end(PARQUET_MAGIC));
+        append(footer);
+    }
+
+    void ParquetFile::append(const std::vector<char>& data)
+    {
+        m_buffer.append(data.data(), data.size());
+        m_position += data.size();
+    }
+
+} // namespace FBExport
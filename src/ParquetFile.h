@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef PARQUET_FILE_H
+#define PARQUET_FILE_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include "CompressSink.h"
+#include "FormatPlan.h"
+#include "sqlda.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FBExport
+{
+    inline constexpr size_t DEFAULT_ROW_GROUP_SIZE = 64 * csv::MIB;
+    // The values of a column are cut into pages of about this size
+    inline constexpr size_t PARQUET_PAGE_SIZE = csv::MIB;
+    // A larger dictionary is not extended, the rest of the column chunk is written as plain values
+    inline constexpr size_t PARQUET_DICTIONARY_SIZE = csv::MIB;
+
+    struct ParquetOptions
+    {
+        // the pages are compressed, gzip and zstd are the Parquet codecs of the same names
+        csv::Compression compression = csv::Compression::NONE;
+        int compressLevel = 0;
+        // size of the values of one row group before compression
+        size_t rowGroupSize = DEFAULT_ROW_GROUP_SIZE;
+        bool dictionary = true;
+        // text columns are marked as UTF-8 strings only when the connection character set is UTF8
+        bool utf8 = true;
+    };
+
+    class ParquetColumn;
+
+    // Writes the rows of one export job to a Parquet file, the counterpart of csv::CSVFile.
+    // The columns keep their Firebird types: integers with a scale are DECIMAL, INT128 is
+    // a 16-byte DECIMAL, dates, times and timestamps are in days and microseconds, timestamps
+    // with a time zone are adjusted to UTC, GUIDs are UUID. DECFLOAT is written as a string.
+    // The values are collected by columns and written in row groups of about rowGroupSize bytes.
+    // Strings are dictionary encoded while the dictionary is small.
+    class ParquetFile final
+    {
+        csv::OutputBuffer& m_buffer;
+        ParquetOptions m_options;
+        std::vector<std::unique_ptr<ParquetColumn>> m_columns;
+        // rows of the written row groups
+        std::vector<uint64_t> m_groups;
+        uint64_t m_groupRows = 0;
+        uint64_t m_position = 0;
+        bool m_closed = false;
+    public:
+        ParquetFile(
+            csv::OutputSink& sink,
+            csv::OutputBuffer& buffer,
+            const Firebird::SQLDAList& fields,
+            const Firebird::SQLDANameList& names,
+            const ParquetOptions& options);
+
+        // An unclosed file is left without the footer, the export has failed
+        ~ParquetFile();
+
+        ParquetFile(const ParquetFile&) = delete;
+        ParquetFile& operator=(const ParquetFile&) = delete;
+
+        csv::OutputBuffer& buffer()
+        {
+            return m_buffer;
+        }
+
+        // BLOB values are read with the connection of the context
+        void writeRow(FormatContext& ctx, const unsigned char* message);
+
+        // Writes the last row group and the footer
+        void close();
+    private:
+        void writeRowGroup();
+
+        void writeFooter();
+
+        void append(const std::vector<char>& data);
+    };
+
+} // namespace FBExport
+
+#endif // PARQUET_FILE_H
@@ -0,0 +1,180 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "PartMerger.h"
+#include <iterator>
+#include <stdexcept>
+
+namespace csv
+{
+
+    PartMerger::PartMerger(size_t memoryLimit)
+        : m_memoryLimit(memoryLimit)
+    {
+    }
+
+    void PartMerger::addFile(
+        const std::string& key,
+        const fs::path& path,
+        size_t partCount,
+        const std::string& header,
+        const std::string& trailer)
+    {
+        auto file = std::make_unique<MergedFile>();
+        file->path = path;
+        file->header = header;
+        file->trailer = trailer;
+        file->index.reserve(partCount);
+        for (size_t i = 0; i < partCount; i++) {
+            file->index.push_back(file->parts.emplace(file->parts.end()));
+        }
+        file->head = file->parts.begin();
+        if (file->head != file->parts.end()) {
+            file->head->head = true;
+        }
+        m_files[key] = std::move(file);
+    }
+
+    PartMerger::PartSink PartMerger::openPart(const std::string& key, size_t partNumber)
+    {
+        auto it = m_files.find(key);
+        if (it == m_files.end() || partNumber >= it->second->index.size()) {
+            throw std::logic_error("Part " + std::to_string(partNumber) + " of " + key + " is not registered");
+        }
+        MergedFile& file = *it->second;
+        return PartSink(*this, file, file.index[partNumber]);
+    }
+
+    PartMerger::PartSink PartMerger::insertAfter(const PartSink& previous)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto part = previous.file_.parts.emplace(std::next(previous.part_));
+        return PartSink(*this, previous.file_, part);
+    }
+
+    void PartMerger::abort()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_aborted = true;
+        }
+        m_cond.notify_all();
+    }
+
+    WriteStats PartMerger::stats() const
+    {
+        WriteStats stats;
+        for (const auto& [key, file] : m_files) {
+            stats += file->stats;
+        }
+        return stats;
+    }
+
+    std::chrono::nanoseconds PartMerger::write(MergedFile& file, Part& part, const char* data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto canWrite = [&] {
+            return m_aborted || part.head || m_pendingSize + size <= m_memoryLimit;
+        };
+        std::chrono::nanoseconds waitTime{ 0 };
+        if (!canWrite()) {
+            const auto start = std::chrono::steady_clock::now();
+            m_cond.wait(lock, canWrite);
+            waitTime = std::chrono::steady_clock::now() - start;
+        }
+        if (m_aborted) {
+            throw std::runtime_error("Export of " + file.path.filename().string() + " is aborted");
+        }
+        if (part.head) {
+            // only the head writes to the file, so the lock is not needed
+            lock.unlock();
+            writeFile(file, data, size);
+            return waitTime;
+        }
+        part.pending.emplace_back(data, data + size);
+        m_pendingSize += size;
+        return waitTime;
+    }
+
+    void PartMerger::finish(MergedFile& file, Part& part)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        part.done = true;
+        if (!part.head) {
+            // the data will be written when all previous parts are done
+            return;
+        }
+        while (file.head != file.parts.end() && file.head->done) {
+            file.head = file.parts.erase(file.head);
+            if (file.head == file.parts.end()) {
+                break;
+            }
+            Part& next = *file.head;
+            // While the next part is not the head its owner keeps adding data
+            // to the pending list, so it is drained until it becomes empty.
+            while (!next.pending.empty()) {
+                auto chunks = std::move(next.pending);
+                next.pending.clear();
+                lock.unlock();
+                size_t written = 0;
+                for (const auto& chunk : chunks) {
+                    writeFile(file, chunk.data(), chunk.size());
+                    written += chunk.size();
+                }
+                lock.lock();
+                m_pendingSize -= written;
+                m_cond.notify_all();
+            }
+            next.head = true;
+            m_cond.notify_all();
+        }
+        if (file.head == file.parts.end()) {
+            // an empty table still has its file
+            if (!file.sink) {
+                openFile(file);
+            }
+            if (!file.trailer.empty()) {
+                file.sink->write(file.trailer.data(), file.trailer.size());
+            }
+            file.sink->close();
+            file.sink.reset();
+        }
+    }
+
+    void PartMerger::writeFile(MergedFile& file, const char* data, size_t size)
+    {
+        // the file is opened by the first write, so only the files in progress are open
+        if (!file.sink) {
+            openFile(file);
+        }
+        file.sink->write(data, size);
+    }
+
+    void PartMerger::openFile(MergedFile& file)
+    {
+        file.sink = std::make_unique<FileSink>(file.path, file.stats);
+        if (!file.header.empty()) {
+            file.sink->write(file.header.data(), file.header.size());
+        }
+    }
+
+} // namespace csv
@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef PART_MERGER_H
+#define PART_MERGER_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "OutputBuffer.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace csv
+{
+    constexpr size_t DEFAULT_MERGE_MEMORY = 256 * MIB;
+
+    class PartMerger;
+
+    // Joins the parts of large tables into the final files without temporary files.
+    // The earliest unfinished part of a file (the head) writes to the file directly.
+    // Parts finished out of order keep their data in memory until all earlier parts
+    // are written; when the common memory limit is exhausted they wait instead.
+    // Parts of one file must be started in ascending order, so the head is always
+    // being exported by some thread and the waiting parts can not block it.
+    class PartMerger final
+    {
+        struct Part
+        {
+            std::deque<std::vector<char>> pending;
+            bool head = false;
+            bool done = false;
+        };
+
+        struct MergedFile
+        {
+            fs::path path;
+            // written before the first part and after the last one
+            std::string header;
+            std::string trailer;
+            WriteStats stats;
+            std::unique_ptr<FileSink> sink;
+            std::list<Part> parts;
+            std::list<Part>::iterator head;
+            std::vector<std::list<Part>::iterator> index;
+        };
+
+        std::map<std::string, std::unique_ptr<MergedFile>> m_files;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        const size_t m_memoryLimit;
+        size_t m_pendingSize = 0;
+        bool m_aborted = false;
+    public:
+        // Output of one part
+        class PartSink final : public OutputSink
+        {
+            friend class PartMerger;
+
+            PartMerger& merger_;
+            MergedFile& file_;
+            std::list<Part>::iterator part_;
+            std::chrono::nanoseconds waitTime_{ 0 };
+        public:
+            PartSink(PartMerger& merger, MergedFile& file, std::list<Part>::iterator part)
+                : merger_(merger)
+                , file_(file)
+                , part_(part)
+            {}
+
+            void write(const char* data, size_t size) override
+            {
+                waitTime_ += merger_.write(file_, *part_, data, size);
+            }
+
+            // Time spent waiting for the memory of the merger
+            std::chrono::nanoseconds waitTime() const
+            {
+                return waitTime_;
+            }
+
+            // The part is complete. If it is the head, the data of the following
+            // finished parts is written to the file by the calling thread.
+            void close() override
+            {
+                merger_.finish(file_, *part_);
+            }
+        };
+
+        explicit PartMerger(size_t memoryLimit = DEFAULT_MERGE_MEMORY);
+
+        PartMerger(const PartMerger&) = delete;
+        PartMerger& operator=(const PartMerger&) = delete;
+
+        // Registers the final file of a table exported in partCount parts.
+        // Must be called before the parts are started. The header and the trailer
+        // of the file format are written as they are, already compressed if needed.
+        void addFile(
+            const std::string& key,
+            const fs::path& path,
+            size_t partCount,
+            const std::string& header = std::string(),
+            const std::string& trailer = std::string());
+
+        PartSink openPart(const std::string& key, size_t partNumber);
+
+        // Adds a new part right after the given one, it gets the data that was 
+        // meant to be the end of that part. The given part must not be finished.
+        PartSink insertAfter(const PartSink& previous);
+
+        // Wakes up all waiting parts after an export error, they throw an exception
+        void abort();
+
+        // I/O counters of all files, valid when all parts are finished
+        WriteStats stats() const;
+    private:
+        // Returns the time spent waiting for the memory
+        std::chrono::nanoseconds write(MergedFile& file, Part& part, const char* data, size_t size);
+
+        void finish(MergedFile& file, Part& part);
+
+        void writeFile(MergedFile& file, const char* data, size_t size);
+
+        // Opens the file and writes its header
+        void openFile(MergedFile& file);
+    };
+
+} // namespace csv
+
+#endif // PART_MERGER_H
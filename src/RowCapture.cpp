@@ -0,0 +1,273 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "RowCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace FBExport
+{
+    namespace
+    {
+        constexpr char CAPTURE_MAGIC[8] = { 'F', 'B', 'C', 'A', 'P', '0', '0', '1' };
+        constexpr size_t CAPTURE_BUFFER_SIZE = 1024 * 1024;
+        // names are much shorter, a longer string is a broken file
+        constexpr uint32_t MAX_CAPTURE_STRING = 64 * 1024;
+
+        template <typename T>
+        void writeValue(std::ostream& out, T value)
+        {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void writeString(std::ostream& out, const std::string& value)
+        {
+            writeValue(out, static_cast<uint32_t>(value.size()));
+            out.write(value.data(), static_cast<std::streamsize>(value.size()));
+        }
+
+        template <typename T>
+        T readValue(std::istream& in)
+        {
+            T value{};
+            in.read(reinterpret_cast<char*>(&value), sizeof(T));
+            return value;
+        }
+
+        // Bytes of the message the formatters read from the offset of a value
+        uint64_t getValueSize(const Firebird::SQLDA& field)
+        {
+            size_t size = 0;
+            switch (field.type) {
+            case SQL_VARYING:
+                return static_cast<uint64_t>(field.length) + sizeof(unsigned short);
+            case SQL_SHORT:
+                size = sizeof(short);
+                break;
+            case SQL_LONG:
+                size = sizeof(ISC_LONG);
+                break;
+            case SQL_FLOAT:
+                size = sizeof(float);
+                break;
+            case SQL_DOUBLE:
+            case SQL_D_FLOAT:
+                size = sizeof(double);
+                break;
+            case SQL_INT64:
+                size = sizeof(ISC_INT64);
+                break;
+            case SQL_INT128:
+                size = sizeof(FB_I128);
+                break;
+            case SQL_DEC16:
+                size = sizeof(FB_DEC16);
+                break;
+            case SQL_DEC34:
+                size = sizeof(FB_DEC34);
+                break;
+            case SQL_BOOLEAN:
+                size = sizeof(FB_BOOLEAN);
+                break;
+            case SQL_TYPE_DATE:
+                size = sizeof(ISC_DATE);
+                break;
+            case SQL_TYPE_TIME:
+                size = sizeof(ISC_TIME);
+                break;
+            case SQL_TIMESTAMP:
+                size = sizeof(ISC_TIMESTAMP);
+                break;
+            case SQL_TIME_TZ:
+                size = sizeof(ISC_TIME_TZ);
+                break;
+            case SQL_TIME_TZ_EX:
+                size = sizeof(ISC_TIME_TZ_EX);
+                break;
+            case SQL_TIMESTAMP_TZ:
+                size = sizeof(ISC_TIMESTAMP_TZ);
+                break;
+            case SQL_TIMESTAMP_TZ_EX:
+                size = sizeof(ISC_TIMESTAMP_TZ_EX);
+                break;
+            case SQL_BLOB:
+            case SQL_ARRAY:
+            case SQL_QUAD:
+                size = sizeof(ISC_QUAD);
+                break;
+            default:
+                break;
+            }
+            // CHAR and the binary strings are read by the declared length
+            return std::max<uint64_t>(size, field.length);
+        }
+
+        std::string readString(std::istream& in)
+        {
+            const auto length = readValue<uint32_t>(in);
+            if (length > MAX_CAPTURE_STRING) {
+                in.setstate(std::ios::failbit);
+                return std::string();
+            }
+            std::string value(length, '\0');
+            in.read(value.data(), static_cast<std::streamsize>(value.size()));
+            return value;
+        }
+    }
+
+    fs::path getCapturePath(const fs::path& dir, const std::string& tableName, uint64_t partNumber)
+    {
+        return dir / (tableName + "." + std::to_string(partNumber) + CAPTURE_EXTENSION);
+    }
+
+    CaptureWriter::CaptureWriter(const fs::path& path, const CaptureHeader& job)
+        : m_buffer(CAPTURE_BUFFER_SIZE)
+        , m_out()
+        , m_header(job)
+    {
+        // the messages are small, so they are collected in a large buffer
+        m_out.rdbuf()->pubsetbuf(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        m_out.exceptions(std::ios::failbit | std::ios::badbit);
+        m_out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+
+    void CaptureWriter::begin(const Firebird::SQLDAList& fields, const Firebird::SQLDANameList& names, unsigned messageLength)
+    {
+        if (m_started) {
+            throw std::logic_error("Capture of " + m_header.tableName + " is already started");
+        }
+        m_started = true;
+        m_header.messageLength = messageLength;
+        m_header.fields = fields;
+        m_header.names = names;
+
+        m_out.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        writeString(m_out, m_header.tableName);
+        writeValue(m_out, m_header.pageSequence);
+        writeValue(m_out, m_header.partNumber);
+        writeValue(m_out, m_header.partCount);
+        writeValue(m_out, m_header.pointerPages);
+        writeValue(m_out, static_cast<uint32_t>(messageLength));
+        writeValue(m_out, static_cast<uint32_t>(fields.size()));
+        for (size_t i = 0; i < fields.size(); i++) {
+            const auto& field = fields[i];
+            writeValue(m_out, static_cast<uint32_t>(field.type));
+            writeValue(m_out, static_cast<int32_t>(field.sub_type));
+            writeValue(m_out, static_cast<uint32_t>(field.length));
+            writeValue(m_out, static_cast<int32_t>(field.scale));
+            writeValue(m_out, static_cast<uint32_t>(field.charset));
+            writeValue(m_out, static_cast<uint32_t>(field.offset));
+            writeValue(m_out, static_cast<uint32_t>(field.nullOffset));
+            writeValue(m_out, static_cast<uint8_t>(field.nullable));
+            const Firebird::SQLDAName name = i < names.size() ? names[i] : Firebird::SQLDAName();
+            writeString(m_out, name.field);
+            writeString(m_out, name.relation);
+            writeString(m_out, name.owner);
+            writeString(m_out, name.alias);
+        }
+    }
+
+    void CaptureWriter::close()
+    {
+        if (m_out.is_open()) {
+            m_out.close();
+        }
+    }
+
+    CaptureReader::CaptureReader(const fs::path& path)
+        : m_path(path)
+        , m_buffer(CAPTURE_BUFFER_SIZE)
+        , m_in()
+    {
+        m_in.rdbuf()->pubsetbuf(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        m_in.open(path, std::ios::in | std::ios::binary);
+        char magic[sizeof(CAPTURE_MAGIC)] = {};
+        m_in.read(magic, sizeof(magic));
+        if (!m_in || !std::equal(std::begin(magic), std::end(magic), std::begin(CAPTURE_MAGIC))) {
+            throw std::runtime_error(path.string() + " is not a capture file");
+        }
+        m_header.tableName = readString(m_in);
+        m_header.pageSequence = readValue<int32_t>(m_in);
+        m_header.partNumber = readValue<uint64_t>(m_in);
+        m_header.partCount = readValue<uint64_t>(m_in);
+        m_header.pointerPages = readValue<int64_t>(m_in);
+        m_header.messageLength = readValue<uint32_t>(m_in);
+        const auto fieldCount = readValue<uint32_t>(m_in);
+        if (!m_in || m_header.messageLength == 0) {
+            throw std::runtime_error(path.string() + " has a broken header");
+        }
+        for (uint32_t i = 0; i < fieldCount && m_in; i++) {
+            Firebird::SQLDA field;
+            field.type = readValue<uint32_t>(m_in);
+            field.sub_type = readValue<int32_t>(m_in);
+            field.length = readValue<uint32_t>(m_in);
+            field.scale = readValue<int32_t>(m_in);
+            field.charset = readValue<uint32_t>(m_in);
+            field.offset = readValue<uint32_t>(m_in);
+            field.nullOffset = readValue<uint32_t>(m_in);
+            field.nullable = readValue<uint8_t>(m_in) != 0;
+            if (field.offset + getValueSize(field) > m_header.messageLength ||
+                field.nullOffset + sizeof(short) > m_header.messageLength) {
+                throw std::runtime_error(path.string() + " has a field outside of the message");
+            }
+            m_header.fields.push_back(field);
+
+            Firebird::SQLDAName name;
+            name.field = readString(m_in);
+            name.relation = readString(m_in);
+            name.owner = readString(m_in);
+            name.alias = readString(m_in);
+            m_header.names.push_back(std::move(name));
+        }
+        if (!m_in) {
+            throw std::runtime_error(path.string() + " has a broken header");
+        }
+        for (const auto& field : m_header.fields) {
+            if (field.type == SQL_VARYING) {
+                m_varying.push_back(&field);
+            }
+        }
+    }
+
+    bool CaptureReader::fetch(Firebird::ThrowStatusWrapper*, unsigned char* message)
+    {
+        m_in.read(reinterpret_cast<char*>(message), m_header.messageLength);
+        const auto length = m_in.gcount();
+        if (length == static_cast<std::streamsize>(m_header.messageLength)) {
+            for (const auto field : m_varying) {
+                unsigned short valueLength = 0;
+                std::memcpy(&valueLength, message + field->offset, sizeof(valueLength));
+                if (valueLength > field->length && *reinterpret_cast<const short*>(message + field->nullOffset) == 0) {
+                    throw std::runtime_error(m_path.string() + " has a string longer than its column");
+                }
+            }
+            return true;
+        }
+        if (length == 0 && m_in.eof()) {
+            return false;
+        }
+        throw std::runtime_error(m_path.string() + " is truncated");
+    }
+
+} // namespace FBExport
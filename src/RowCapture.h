@@ -0,0 +1,156 @@
+#pragma once
+
+#ifndef ROW_CAPTURE_H
+#define ROW_CAPTURE_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "sqlda.h"
+#include <firebird/Interface.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace FBExport
+{
+    // Messages of one cursor, fetched from the server or read from a capture
+    class RowSource
+    {
+    public:
+        virtual ~RowSource() = default;
+
+        // Fills the message buffer, returns false when the rows are over
+        virtual bool fetch(Firebird::ThrowStatusWrapper* status, unsigned char* message) = 0;
+    };
+
+    class CursorSource final : public RowSource
+    {
+        Firebird::IResultSet* m_rs;
+    public:
+        explicit CursorSource(Firebird::IResultSet* rs)
+            : m_rs(rs)
+        {}
+
+        bool fetch(Firebird::ThrowStatusWrapper* status, unsigned char* message) override
+        {
+            return m_rs->fetchNext(status, message) == Firebird::IStatus::RESULT_OK;
+        }
+    };
+
+    inline constexpr char CAPTURE_EXTENSION[] = ".fbcap";
+
+    // The job and the output message of a capture file
+    struct CaptureHeader
+    {
+        std::string tableName;
+        int32_t pageSequence = 0;
+        uint64_t partNumber = 0;
+        uint64_t partCount = 1;
+        int64_t pointerPages = 1;
+        unsigned messageLength = 0;
+        Firebird::SQLDAList fields;
+        Firebird::SQLDANameList names;
+    };
+
+    // File of the job in the capture directory
+    fs::path getCapturePath(const fs::path& dir, const std::string& tableName, uint64_t partNumber);
+
+    // Saves the raw messages of one job. The file starts with the header, the messages
+    // follow it as they are, in the fetch order. Numbers are in the byte order of the
+    // machine, as in the messages themselves.
+    class CaptureWriter final
+    {
+        std::vector<char> m_buffer;
+        std::ofstream m_out;
+        CaptureHeader m_header;
+        bool m_started = false;
+    public:
+        // The job part of the header, the message part is added by begin()
+        CaptureWriter(const fs::path& path, const CaptureHeader& job);
+
+        CaptureWriter(const CaptureWriter&) = delete;
+        CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+        // Writes the header, called when the cursor is open
+        void begin(const Firebird::SQLDAList& fields, const Firebird::SQLDANameList& names, unsigned messageLength);
+
+        void write(const unsigned char* message)
+        {
+            m_out.write(reinterpret_cast<const char*>(message), m_header.messageLength);
+        }
+
+        void close();
+    };
+
+    // Records every message of the wrapped source
+    class CaptureSource final : public RowSource
+    {
+        RowSource& m_source;
+        CaptureWriter& m_writer;
+    public:
+        CaptureSource(RowSource& source, CaptureWriter& writer)
+            : m_source(source)
+            , m_writer(writer)
+        {}
+
+        bool fetch(Firebird::ThrowStatusWrapper* status, unsigned char* message) override
+        {
+            if (!m_source.fetch(status, message)) {
+                return false;
+            }
+            m_writer.write(message);
+            return true;
+        }
+    };
+
+    // Returns the messages of a capture file. Throws std::runtime_error
+    // if the file is not a capture, is truncated or its values do not fit the message.
+    class CaptureReader final : public RowSource
+    {
+        fs::path m_path;
+        std::vector<char> m_buffer;
+        std::ifstream m_in;
+        CaptureHeader m_header;
+        // VARCHAR columns, the length of each value is checked against the column
+        std::vector<const Firebird::SQLDA*> m_varying;
+    public:
+        explicit CaptureReader(const fs::path& path);
+
+        CaptureReader(const CaptureReader&) = delete;
+        CaptureReader& operator=(const CaptureReader&) = delete;
+
+        const CaptureHeader& header() const
+        {
+            return m_header;
+        }
+
+        bool fetch(Firebird::ThrowStatusWrapper* status, unsigned char* message) override;
+    };
+
+} // namespace FBExport
+
+#endif // ROW_CAPTURE_H
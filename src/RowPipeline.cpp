@@ -0,0 +1,250 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "RowPipeline.h"
+#include <cstddef>
+#include <string>
+#include <thread>
+
+namespace FBExport
+{
+
+    RowPipeline::RowPipeline(
+        Firebird::IMaster* master,
+        const FormatPlan& plan,
+        const FormatOptions& options,
+        unsigned messageLength,
+        unsigned formatThreads)
+        : m_master(master)
+        , m_plan(plan)
+        , m_options(options)
+        // every message in the slab must be aligned like the standalone buffer
+        , m_stride((messageLength + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1))
+        , m_slabRows(m_stride < PIPELINE_SLAB_SIZE ? PIPELINE_SLAB_SIZE / m_stride : 1)
+        , m_formatThreads(formatThreads > 0 ? formatThreads : 1)
+        // two items per formatter keep the fetch stage busy while the slabs are formatted
+        , m_slabs(2 * m_formatThreads + 1)
+        , m_blocks(2 * m_formatThreads + 1)
+    {
+        for (auto& slab : m_slabs) {
+            slab.messages.resize(m_slabRows * m_stride);
+            m_freeSlabs.push_back(&slab);
+        }
+        for (auto& block : m_blocks) {
+            m_freeBlocks.push_back(&block);
+        }
+    }
+
+    void RowPipeline::run(
+        Firebird::ThrowStatusWrapper* status, 
+        RowSource& source, 
+        csv::CSVFile& csv, 
+        RowMeter& meter,
+        const AcceptFunc& accept)
+    {
+        m_timed = meter.timed();
+        std::vector<std::thread> threads;
+        threads.reserve(m_formatThreads + 1);
+        try {
+            for (unsigned i = 0; i < m_formatThreads; i++) {
+                threads.emplace_back(&RowPipeline::formatLoop, this, csv.separator());
+            }
+            threads.emplace_back(&RowPipeline::writeLoop, this, std::ref(csv));
+            fetchLoop(status, source, meter, accept);
+        }
+        catch (...) {
+            abort(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fetchDone = true;
+        }
+        m_formatReady.notify_all();
+        m_blockReady.notify_all();
+
+        for (auto& th : threads) {
+            th.join();
+        }
+        meter.addFormatTime(m_formatTime);
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    void RowPipeline::fetchLoop(Firebird::ThrowStatusWrapper* status, RowSource& source, RowMeter& meter, const AcceptFunc& accept)
+    {
+        bool eof = false;
+        while (!eof) {
+            Slab* slab = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_slabFreed.wait(lock, [this] { return m_aborted || !m_freeSlabs.empty(); });
+                if (m_aborted) {
+                    return;
+                }
+                slab = m_freeSlabs.back();
+                m_freeSlabs.pop_back();
+            }
+
+            // the messages are fetched directly into the slab, no copy is needed
+            slab->rows = 0;
+            unsigned char* message = slab->messages.data();
+            meter.restart();
+            while (slab->rows < m_slabRows) {
+                const bool fetched = source.fetch(status, message);
+                meter.fetched();
+                if (!fetched || (accept && !accept(message))) {
+                    eof = true;
+                    break;
+                }
+                meter.row();
+                slab->rows++;
+                message += m_stride;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (slab->rows > 0) {
+                    slab->seq = m_slabCount++;
+                    m_filledSlabs.push_back(slab);
+                }
+                else {
+                    m_freeSlabs.push_back(slab);
+                }
+            }
+            m_formatReady.notify_one();
+        }
+    }
+
+    void RowPipeline::formatLoop(char separator)
+    {
+        Firebird::ThrowStatusWrapper status(m_master->getStatus());
+        try {
+            FormatContext ctx(&status, m_master, m_options);
+            csv::OutputBuffer buffer(PIPELINE_FORMAT_BUFFER_SIZE);
+            csv::MemorySink sink;
+            const std::string separatorString(1, separator);
+
+            while (true) {
+                Slab* slab = nullptr;
+                Block* block = nullptr;
+                {
+                    // The slab and the block are taken together. A formatter never holds a slab
+                    // while waiting for a block, so the oldest slab can always be completed.
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_formatReady.wait(lock, [this] {
+                        return m_aborted
+                            || (!m_filledSlabs.empty() && !m_freeBlocks.empty())
+                            || (m_fetchDone && m_filledSlabs.empty());
+                    });
+                    if (m_aborted || m_filledSlabs.empty()) {
+                        break;
+                    }
+                    slab = m_filledSlabs.front();
+                    m_filledSlabs.pop_front();
+                    block = m_freeBlocks.back();
+                    m_freeBlocks.pop_back();
+                }
+
+                block->seq = slab->seq;
+                block->text.clear();
+                sink.setTarget(&block->text);
+                const auto start = m_timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+                csv::CSVFile csv(sink, buffer, separatorString);
+                const unsigned char* message = slab->messages.data();
+                for (size_t i = 0; i < slab->rows; i++, message += m_stride) {
+                    m_plan.formatRow(ctx, message, csv);
+                }
+                csv.close();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (m_timed) {
+                        m_formatTime += std::chrono::steady_clock::now() - start;
+                    }
+                    m_freeSlabs.push_back(slab);
+                    m_readyBlocks.emplace(block->seq, block);
+                }
+                m_slabFreed.notify_one();
+                m_blockReady.notify_one();
+            }
+        }
+        catch (...) {
+            abort(std::current_exception());
+        }
+        status.dispose();
+    }
+
+    void RowPipeline::writeLoop(csv::CSVFile& csv)
+    {
+        try {
+            while (true) {
+                Block* block = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_blockReady.wait(lock, [this] {
+                        return m_aborted
+                            || m_readyBlocks.count(m_nextWrite) > 0
+                            || (m_fetchDone && m_nextWrite == m_slabCount);
+                    });
+                    if (m_aborted) {
+                        return;
+                    }
+                    auto it = m_readyBlocks.find(m_nextWrite);
+                    if (it == m_readyBlocks.end()) {
+                        // all slabs are written
+                        return;
+                    }
+                    block = it->second;
+                    m_readyBlocks.erase(it);
+                }
+
+                csv.buffer().append(block->text.data(), block->text.size());
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_nextWrite++;
+                    m_freeBlocks.push_back(block);
+                }
+                m_formatReady.notify_one();
+            }
+        }
+        catch (...) {
+            abort(std::current_exception());
+        }
+    }
+
+    void RowPipeline::abort(std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_error) {
+                m_error = error;
+            }
+            m_aborted = true;
+        }
+        m_slabFreed.notify_all();
+        m_formatReady.notify_all();
+        m_blockReady.notify_all();
+    }
+
+} // namespace FBExport
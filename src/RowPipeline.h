@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef ROW_PIPELINE_H
+#define ROW_PIPELINE_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "CSVFile.h"
+#include "FormatPlan.h"
+#include "ExportMetrics.h"
+#include "RowCapture.h"
+#include <firebird/Interface.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace FBExport
+{
+    // Raw messages fetched by one pass of the fetch stage
+    constexpr size_t PIPELINE_SLAB_SIZE = csv::MIB;
+    // Buffer of each formatter thread, its content is moved to the text block
+    constexpr size_t PIPELINE_FORMAT_BUFFER_SIZE = 256 * 1024;
+
+    // Splits the export of one cursor into three stages working in parallel.
+    // The calling thread fetches raw messages into pooled slabs, the formatter threads
+    // turn every slab into a block of CSV text, and the writer thread passes the blocks
+    // to the file in the fetch order. The number of slabs and blocks is limited,
+    // so a slow stage holds back the others instead of accumulating data.
+    class RowPipeline final
+    {
+        struct Slab
+        {
+            std::vector<unsigned char> messages;
+            size_t rows = 0;
+            uint64_t seq = 0;
+        };
+
+        struct Block
+        {
+            std::vector<char> text;
+            uint64_t seq = 0;
+        };
+
+        Firebird::IMaster* m_master;
+        const FormatPlan& m_plan;
+        const FormatOptions& m_options;
+        const size_t m_stride;
+        const size_t m_slabRows;
+        const unsigned m_formatThreads;
+        bool m_timed = false;
+
+        std::vector<Slab> m_slabs;
+        std::vector<Block> m_blocks;
+
+        std::mutex m_mutex;
+        std::condition_variable m_slabFreed;
+        std::condition_variable m_formatReady;
+        std::condition_variable m_blockReady;
+        std::vector<Slab*> m_freeSlabs;
+        std::deque<Slab*> m_filledSlabs;
+        std::vector<Block*> m_freeBlocks;
+        std::map<uint64_t, Block*> m_readyBlocks;
+        uint64_t m_slabCount = 0;
+        uint64_t m_nextWrite = 0;
+        bool m_fetchDone = false;
+        bool m_aborted = false;
+        std::exception_ptr m_error;
+        std::chrono::nanoseconds m_formatTime{ 0 };
+    public:
+        RowPipeline(
+            Firebird::IMaster* master,
+            const FormatPlan& plan,
+            const FormatOptions& options,
+            unsigned messageLength,
+            unsigned formatThreads);
+
+        RowPipeline(const RowPipeline&) = delete;
+        RowPipeline& operator=(const RowPipeline&) = delete;
+
+        // Called by the fetch stage for every message, false stops the export
+        using AcceptFunc = std::function<bool(const unsigned char* message)>;
+
+        // Exports all rows of the source, rethrows the first error of any stage.
+        // The meter gets the fetch time and the format time of all formatter threads.
+        void run(
+            Firebird::ThrowStatusWrapper* status, 
+            RowSource& source, 
+            csv::CSVFile& csv, 
+            RowMeter& meter,
+            const AcceptFunc& accept = AcceptFunc());
+    private:
+        void fetchLoop(Firebird::ThrowStatusWrapper* status, RowSource& source, RowMeter& meter, const AcceptFunc& accept);
+
+        void formatLoop(char separator);
+
+        void writeLoop(csv::CSVFile& csv);
+
+        void abort(std::exception_ptr error);
+    };
+
+} // namespace FBExport
+
+#endif // ROW_PIPELINE_H
@@ -0,0 +1,174 @@
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include "TemporalFormat.h"
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+    // ISC_DATE counts days from 1858-11-17 (Modified Julian Day), 1970-01-01 is day 40587
+    constexpr int ISC_DATE_UNIX_EPOCH = 40587;
+
+    constexpr char DIGIT_PAIRS[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    inline char* write2(char* out, unsigned value)
+    {
+        std::memcpy(out, DIGIT_PAIRS + value * 2, 2);
+        return out + 2;
+    }
+
+    inline char* write4(char* out, unsigned value)
+    {
+        write2(out, value / 100);
+        write2(out + 2, value % 100);
+        return out + 4;
+    }
+
+    struct CivilDate
+    {
+        int year;
+        unsigned month;
+        unsigned day;
+    };
+
+    // Howard Hinnant's civil_from_days algorithm, days are counted from 1970-01-01
+    CivilDate civilFromDays(int64_t z)
+    {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const auto doe = static_cast<unsigned>(z - era * 146097);                // [0, 146096]
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;  // [0, 399]
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);            // [0, 365]
+        const unsigned mp = (5 * doy + 2) / 153;                                 // [0, 11]
+        const unsigned d = doy - (153 * mp + 2) / 5 + 1;                         // [1, 31]
+        const unsigned m = mp < 10 ? mp + 3 : mp - 9;                            // [1, 12]
+        const auto y = static_cast<int>(static_cast<int64_t>(yoe) + era * 400 + (m <= 2));
+        return { y, m, d };
+    }
+} // namespace
+
+namespace FBExport
+{
+
+    char* formatDate(char* out, ISC_DATE date)
+    {
+        const auto civil = civilFromDays(static_cast<int64_t>(date) - ISC_DATE_UNIX_EPOCH);
+        out = std::to_chars(out, out + 6, civil.year).ptr;
+        *out++ = '-';
+        out = write2(out, civil.month);
+        *out++ = '-';
+        return write2(out, civil.day);
+    }
+
+    char* formatTime(char* out, ISC_TIME time)
+    {
+        const unsigned fractions = time % ISC_TICKS_PER_SECOND;
+        unsigned seconds = time / ISC_TICKS_PER_SECOND;
+        const unsigned hours = seconds / 3600;
+        seconds %= 3600;
+        out = write2(out, hours);
+        *out++ = ':';
+        out = write2(out, seconds / 60);
+        *out++ = ':';
+        out = write2(out, seconds % 60);
+        *out++ = '.';
+        return write4(out, fractions);
+    }
+
+    char* formatTimestamp(char* out, const ISC_TIMESTAMP& timestamp)
+    {
+        out = formatDate(out, timestamp.timestamp_date);
+        *out++ = ' ';
+        return formatTime(out, timestamp.timestamp_time);
+    }
+
+    char* formatTimeZoneOffset(char* out, int offsetMinutes)
+    {
+        *out++ = offsetMinutes < 0 ? '-' : '+';
+        const auto minutes = static_cast<unsigned>(offsetMinutes < 0 ? -offsetMinutes : offsetMinutes);
+        out = write2(out, minutes / 60);
+        *out++ = ':';
+        return write2(out, minutes % 60);
+    }
+
+    ISC_TIMESTAMP shiftTimestamp(const ISC_TIMESTAMP& timestamp, int offsetMinutes)
+    {
+        const int64_t ticksPerDay = ISC_TICKS_PER_DAY;
+        int64_t ticks = static_cast<int64_t>(timestamp.timestamp_time) + 
+            static_cast<int64_t>(offsetMinutes) * 60 * ISC_TICKS_PER_SECOND;
+        ISC_DATE date = timestamp.timestamp_date;
+        if (ticks < 0) {
+            ticks += ticksPerDay;
+            date--;
+        }
+        else if (ticks >= ticksPerDay) {
+            ticks -= ticksPerDay;
+            date++;
+        }
+        return { date, static_cast<ISC_TIME>(ticks) };
+    }
+
+    ISC_TIME shiftTime(ISC_TIME time, int offsetMinutes)
+    {
+        const int64_t ticksPerDay = ISC_TICKS_PER_DAY;
+        int64_t ticks = (static_cast<int64_t>(time) + 
+            static_cast<int64_t>(offsetMinutes) * 60 * ISC_TICKS_PER_SECOND) % ticksPerDay;
+        if (ticks < 0) {
+            ticks += ticksPerDay;
+        }
+        return static_cast<ISC_TIME>(ticks);
+    }
+
+    std::string_view TimeZoneNameCache::get(Firebird::ThrowStatusWrapper* status, Firebird::IUtil* util, unsigned short zoneId)
+    {
+        auto it = m_names.find(zoneId);
+        if (it == m_names.end()) {
+            // the name does not depend on the time, any value will do
+            ISC_TIMESTAMP_TZ value{};
+            value.time_zone = zoneId;
+            unsigned int year, month, day;
+            unsigned int hours, minutes, seconds, fractions;
+            char tzBuffer[64] = { 0 };
+            util->decodeTimeStampTz(
+                status, &value,
+                &year, &month, &day,
+                &hours, &minutes, &seconds, &fractions,
+                static_cast<unsigned int>(std::size(tzBuffer)),
+                tzBuffer
+            );
+            it = m_names.emplace(zoneId, tzBuffer).first;
+        }
+        return it->second;
+    }
+
+} // namespace FBExport
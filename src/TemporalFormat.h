@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef TEMPORAL_FORMAT_H
+#define TEMPORAL_FORMAT_H
+
+/*
+ *  The contents of this file are subject to the Initial
+ *  Developer's Public License Version 1.0 (the "License");
+ *  you may not use this file except in compliance with the
+ *  License. You may obtain a copy of the License at
+ *  http://www.firebirdsql.org/en/initial-developer-s-public-license-version-1-0/.
+ *
+ *  Software distributed under the License is distributed AS IS,
+ *  WITHOUT WARRANTY OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing rights
+ *  and limitations under the License.
+ *
+ *  The Original Code was created by Simonov Denis
+ *  for the open source project "Firebird CSVExport".
+ *
+ *  Copyright (c) 2023 Simonov Denis <sim-mail@list.ru>
+ *  and all contributors signed below.
+ *
+ *  All Rights Reserved.
+ *  Contributor(s): ______________________________________.
+ */
+
+#include <firebird/Interface.h>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace FBExport
+{
+    // "YYYY-MM-DD"
+    inline constexpr size_t MAX_DATE_LENGTH = 12;
+    // "HH:MM:SS.FFFF"
+    inline constexpr size_t MAX_TIME_LENGTH = 13;
+    inline constexpr size_t MAX_TIMESTAMP_LENGTH = MAX_DATE_LENGTH + 1 + MAX_TIME_LENGTH;
+    // "+HH:MM"
+    inline constexpr size_t MAX_TIME_ZONE_OFFSET_LENGTH = 6;
+
+    // ISC_TIME is measured in 1/10000 of a second
+    inline constexpr ISC_TIME ISC_TICKS_PER_SECOND = 10000;
+    inline constexpr ISC_TIME ISC_TICKS_PER_DAY = 24 * 60 * 60 * ISC_TICKS_PER_SECOND;
+
+    // The following functions write the value starting at out and return
+    // the pointer past the last written character. The output format is the same
+    // as the one produced by IUtil::decodeXXX functions followed by printf.
+
+    char* formatDate(char* out, ISC_DATE date);
+
+    char* formatTime(char* out, ISC_TIME time);
+
+    char* formatTimestamp(char* out, const ISC_TIMESTAMP& timestamp);
+
+    char* formatTimeZoneOffset(char* out, int offsetMinutes);
+
+    // Firebird encodes the offset time zones (+HH:MM) directly in the zone id
+    inline constexpr unsigned short TIME_ZONE_ONE_DAY = 24 * 60 - 1;
+
+    inline bool isOffsetTimeZone(unsigned short zoneId)
+    {
+        return zoneId <= TIME_ZONE_ONE_DAY * 2;
+    }
+
+    inline int offsetTimeZoneMinutes(unsigned short zoneId)
+    {
+        return static_cast<int>(zoneId) - TIME_ZONE_ONE_DAY;
+    }
+
+    // Converts UTC value to the local time of the given offset
+    ISC_TIMESTAMP shiftTimestamp(const ISC_TIMESTAMP& timestamp, int offsetMinutes);
+
+    ISC_TIME shiftTime(ISC_TIME time, int offsetMinutes);
+
+    // Names of the region time zones by id. The time zone database is
+    // queried only the first time an id is met.
+    class TimeZoneNameCache
+    {
+        std::unordered_map<unsigned short, std::string> m_names;
+    public:
+        std::string_view get(Firebird::ThrowStatusWrapper* status, Firebird::IUtil* util, unsigned short zoneId);
+    };
+
+} // namespace FBExport
+
+#endif // TEMPORAL_FORMAT_H
@@ -21,7 +21,6 @@
  */
 
 #include "sqlda.h"
-#include <string>
 
 namespace {
 
@@ -35,18 +34,6 @@ namespace {
         for (unsigned i = 0; i < cnt; i++) {
             auto&& sqlda = fields.emplace_back();
 
-            std::string field(metadata->getField(status, i));
-            field.copy(sqlda.field, field.size());
-
-            std::string relation(metadata->getRelation(status, i));
-            relation.copy(sqlda.relation, relation.size());
-
-            std::string alias(metadata->getAlias(status, i));
-            alias.copy(sqlda.alias, alias.size());
-
-            std::string owner(metadata->getOwner(status, i));
-            owner.copy(sqlda.owner, owner.size());
-
             sqlda.type = metadata->getType(status, i);
             sqlda.nullable = metadata->isNullable(status, i);
             sqlda.sub_type = metadata->getSubType(status, i);
@@ -58,6 +45,23 @@ namespace {
             sqlda.nullOffset = metadata->getNullOffset(status, i);
         }
     }
+
+    template <typename StatusType>
+    void _fillSQLDANames(StatusType* status, Firebird::IMessageMetadata* metadata, Firebird::SQLDANameList& names)
+    {
+        unsigned cnt = metadata->getCount(status);
+        names.reserve(cnt);
+        names.clear();
+
+        for (unsigned i = 0; i < cnt; i++) {
+            auto&& name = names.emplace_back();
+
+            name.field = metadata->getField(status, i);
+            name.relation = metadata->getRelation(status, i);
+            name.owner = metadata->getOwner(status, i);
+            name.alias = metadata->getAlias(status, i);
+        }
+    }
 } // namespace
 
 namespace Firebird
@@ -73,4 +77,14 @@ namespace Firebird
         _fillSQLDA(status, metadata, fields);
     }
 
+    void fillSQLDANames(CheckStatusWrapper* status, IMessageMetadata* metadata, SQLDANameList& names)
+    {
+        _fillSQLDANames(status, metadata, names);
+    }
+
+    void fillSQLDANames(ThrowStatusWrapper* status, IMessageMetadata* metadata, SQLDANameList& names)
+    {
+        _fillSQLDANames(status, metadata, names);
+    }
+
 } // namespace Firebird
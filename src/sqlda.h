@@ -26,16 +26,14 @@
  */
 
 #include "firebird/Interface.h"
+#include <string>
 #include <vector>
 
 namespace Firebird
 {
 
+    // Only what is needed to read the values from the message buffer
     struct SQLDA {
-        char field[63 * 4]{ "" };
-        char relation[63 * 4]{ "" };
-        char owner[63 * 4]{ "" };
-        char alias[63 * 4]{ "" };
         unsigned type = 0;     
         int sub_type = 0;
         unsigned length = 0;
@@ -46,11 +44,24 @@ namespace Firebird
         bool nullable = false;
     };
 
+    // Column names, they are needed only for the header
+    struct SQLDAName {
+        std::string field;
+        std::string relation;
+        std::string owner;
+        std::string alias;
+    };
+
     using SQLDAList = std::vector<SQLDA>;
+    using SQLDANameList = std::vector<SQLDAName>;
 
     void fillSQLDA(CheckStatusWrapper* status, IMessageMetadata* metadata, SQLDAList& fields);
 
     void fillSQLDA(ThrowStatusWrapper* status, IMessageMetadata* metadata, SQLDAList& fields);
+
+    void fillSQLDANames(CheckStatusWrapper* status, IMessageMetadata* metadata, SQLDANameList& names);
+
+    void fillSQLDANames(ThrowStatusWrapper* status, IMessageMetadata* metadata, SQLDANameList& names);
     
 } // namespace Firebird
 